@@ -0,0 +1,63 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+
+// Bump allocator for the AST. Every node of a program lives in a few big
+// chunks, so walking the tree touches contiguous memory and tearing the
+// program down is one release of the chunks instead of a free per node.
+class Arena
+{
+public:
+    Arena(size_t chunkSize = 64 * 1024);
+    ~Arena();
+
+    void *allocate(size_t size, size_t align);
+
+    void release();
+
+    size_t bytesUsed() const { return used; }
+    size_t bytesReserved() const { return reserved; }
+    size_t chunkCount() const { return chunks.size(); }
+
+private:
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    std::vector<char *> chunks;
+    size_t chunkSize;
+    char *cursor;
+    char *limit;
+    size_t used;
+    size_t reserved;
+};
+
+// Allocator used with std::allocate_shared. The node and its control block
+// share one arena block, deallocate is a no-op and the arena stays alive
+// until the last node built from it is gone.
+template <typename T>
+struct ArenaAllocator
+{
+    typedef T value_type;
+
+    std::shared_ptr<Arena> arena;
+
+    ArenaAllocator(std::shared_ptr<Arena> arena) : arena(std::move(arena)) {}
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+
+    T *allocate(size_t n)
+    {
+        return static_cast<T *>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *, size_t) {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U> &other) const { return arena == other.arena; }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U> &other) const { return arena != other.arena; }
+};
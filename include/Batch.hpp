@@ -0,0 +1,36 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+
+class Interpreter;
+
+struct BatchJob
+{
+    std::string name;
+    std::string source;
+};
+
+// How one job of a batch ended.
+struct BatchResult
+{
+    std::string name;
+    bool compiled;
+    // the error that stopped the run, empty when it ran all its frames or ended
+    std::string error;
+    size_t frames;
+    size_t processes;
+    size_t ticks;
+    double elapsed;
+};
+
+// Called on the job's thread after its last frame, before the interpreter
+// is released, to read whatever the caller wants out of it.
+typedef std::function<void(Interpreter &interpreter, BatchResult &result)> BatchCollect;
+
+// Runs every job in an interpreter of its own, threads of them at a time,
+// for at most frames frames each and without a window. Every interpreter
+// has its own scene, literal factory, process ids and random state, so the
+// jobs do not see each other. The results come back in job order.
+std::vector<BatchResult> RunBatch(const std::vector<BatchJob> &jobs, size_t frames, size_t threads,
+                                  const BatchCollect &collect = nullptr);
@@ -7,6 +7,7 @@
 #include <string>
 #include <unordered_map>
 #include <raylib.h>
+#include "Memory.hpp"
 
 #define BLEND_ALPHAMULT 6
 #define BLEND_ALPHABLEND 2
@@ -128,12 +129,13 @@ public:
         id = -1;
         texture = {0};
         image = {0};
+        clip = {0, 0, 0, 0};
         isClip = false;
     };
 
     inline int GetWidth() const { return texture.width; }
     inline int GetHeight() const { return texture.height; }
-    std::vector<Vec2> points;
+    std::vector<Vec2, MemoryAllocator<Vec2, MEMORY_SCENE>> points;
     std::string name;
     Texture2D texture;
     Image image;
@@ -192,7 +194,9 @@ public:
 //********************** MATRIX2D ****************************/
 //************************************************************/
 
-class Instance
+typedef std::vector<Instance *, MemoryAllocator<Instance *, MEMORY_SCENE>> InstanceList;
+
+class Instance : public MemoryTracked<MEMORY_SCENE>
 {
 private:
     long m_id;
@@ -241,12 +245,22 @@ public:
     bool showPivot{false};
     double _x{0};
     double _y{0};
+    // transform at the previous simulation step, blended with the current one when drawn
+    double prevX{0};
+    double prevY{0};
+    double prevAngle{0};
+    // false until a step starts with the instance on the scene, the first
+    // frames of a new instance are drawn where it is, not blended from 0,0
+    bool stepped{false};
     Instance *m_parent{nullptr};
 
     void Destroy();
+    // back to a freshly constructed instance, keeps the allocated storage
+    void reset();
 
     void Update(double delta);
     void Render();
+    void SaveState();
 
     void setGraph(int id);
 
@@ -271,6 +285,8 @@ public:
     void setPivot(double x, double y);
     void CenterPivot();
     void setParent(Instance *parent);
+    // unparent, keeping the place and rotation it had on screen
+    void detach();
 
 
 
@@ -303,8 +319,11 @@ public:
 class Scene
 {
 private:
-    std::vector<Instance *> m_entities;
-    std::unordered_map<int, std::vector<Instance *>> m_layers;
+    InstanceList m_entities;
+    // dead instances kept for CreateInstance() to hand out again
+    InstanceList m_pool;
+    std::unordered_map<int, InstanceList, std::hash<int>, std::equal_to<int>,
+                       MemoryAllocator<std::pair<const int, InstanceList>, MEMORY_SCENE>> m_layers;
     int m_num_layers{0};
 
     Color clearColor;
@@ -314,21 +333,50 @@ private:
     float rotation; // Camera rotation in degrees
     float zoom;     // Camera zoom (scaling), should be 1.0f by default
     Rectangle bound;
+    double fixedStep{0};
+    // simulation transforms put aside while the interpolated ones are drawn
+    std::vector<double, MemoryAllocator<double, MEMORY_SCENE>> m_state;
+
+    void BeginInterpolation(double alpha);
+    void EndInterpolation();
 
+    static thread_local Scene *current;
 
+public:
     Scene();
     virtual ~Scene();
 
-public:
+    // the scene bound to this thread by its interpreter, a process wide one
+    // when there is none
     static Scene &Get()
     {
+        if (current)
+            return *current;
         static Scene scene;
         return scene;
     }
+    // returns the scene bound before
+    static Scene *Bind(Scene *scene)
+    {
+        Scene *previous = current;
+        current = scene;
+        return previous;
+    }
+    static bool IsBound(const Scene *scene) { return current == scene; }
     void Refresh();
 
     void Update(float delta);
-    void UpdateAndRefresh();
+    // alpha is how far the frame is between the last two simulation steps,
+    // instances are drawn that far from their previous transform
+    void UpdateAndRefresh(double alpha = 1.0);
+    // the part of UpdateAndRefresh before drawing: updates the instances,
+    // blends them by alpha and works out their world transforms
+    void Prepare(double delta, double alpha = 1.0);
+    // keep the transforms of the step about to run over, before each step
+    void SaveState();
+    // seconds of a simulation step, 0 steps once per rendered frame
+    void SetFixedStep(double seconds) { fixedStep = seconds; }
+    double GetDeltaTime() const { return fixedStep > 0 ? fixedStep : GetFrameTime(); }
 
     void UpdateBehaviourInstances();
 
@@ -351,7 +399,8 @@ public:
 
     Instance *FindInstanceByName(const std::string &name);
 
-    std::unordered_map<int, Graph> graphics;
+    std::unordered_map<int, Graph, std::hash<int>, std::equal_to<int>,
+                       MemoryAllocator<std::pair<const int, Graph>, MEMORY_SCENE>> graphics;
 
     std::unordered_map<std::string, Texture2D> texture_list;
     std::string gameName;
@@ -377,6 +426,8 @@ public:
 
     bool InScreen(Instance *e);
 
-    const std::vector<Instance *> &GetEntities() { return m_entities; }
-    const std::vector<Instance *> &GetLayerEntities(int layer) { return m_layers[layer]; }
+    const InstanceList &GetEntities() { return m_entities; }
+    size_t PooledInstances() const { return m_pool.size(); }
+    void ReserveInstances(size_t count) { m_entities.reserve(m_entities.size() + count); }
+    const InstanceList &GetLayerEntities(int layer) { return m_layers[layer]; }
 };
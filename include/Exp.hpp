@@ -20,6 +20,8 @@ enum ExprType
     FUNCTIONCALL,
     CALLER,
     PROCESSCALL,
+    FIELD,
+    FIELD_ASSIGN,
     MAX
 };
 
@@ -65,6 +67,10 @@ struct Expr
                 return "CALLER";   
             case PROCESSCALL:
                 return "ProcessCall";
+            case FIELD:
+                return "Field";
+            case FIELD_ASSIGN:
+                return "FieldAssign";
             default:
                 return "Unknow: "+std::to_string((int)getType());
         }
@@ -97,6 +103,10 @@ struct LiteralExpr : public Expr
 
     LiteralExpr(const std::string &value) : value(value) {}
 
+    LiteralExpr(HeapObject *value) : value(value) {}
+
+    LiteralExpr(const Literal &value) : value(value) {}
+
     ExprType getType() const override     {        return ExprType::LITERAL;    }
 
     virtual ~LiteralExpr();
@@ -196,6 +206,31 @@ struct AssignExpr : public Expr
 
 
 
+// process.field, object evaluates to a process id. slot is the built-in
+// slot the parser found for the name, -1 for a local the process declares
+struct FieldExpr : public Expr
+{
+    std::shared_ptr<Expr> object;
+    Token name;
+    int slot;
+    // id of a name that is not a built-in, shared by every field of the program with that name
+    int field;
+    FieldExpr(std::shared_ptr<Expr> object, const Token &name, int slot, int field) : object(std::move(object)), name(name), slot(slot), field(field) {}
+
+    ExprType getType() const override    {        return ExprType::FIELD;    }
+    std::shared_ptr<Expr> accept(Visitor *visitor) override;
+};
+
+struct FieldAssignExpr : public Expr
+{
+    std::shared_ptr<FieldExpr> field;
+    std::shared_ptr<Expr> value;
+    FieldAssignExpr(std::shared_ptr<FieldExpr> field, std::shared_ptr<Expr> value) : field(std::move(field)), value(std::move(value)) {}
+
+    ExprType getType() const override    {        return ExprType::FIELD_ASSIGN;    }
+    std::shared_ptr<Expr> accept(Visitor *visitor) override;
+};
+
 struct NowExpr : public Expr
 {
     ExprType getType() const override    {        return ExprType::NOW;    }
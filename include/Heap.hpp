@@ -0,0 +1,161 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include "Literal.hpp"
+#include "Memory.hpp"
+
+class Heap;
+
+enum HeapObjectType
+{
+    HEAP_LIST,
+    HEAP_MAP,
+};
+
+// Reference-typed script value. Literals only carry the pointer, the heap
+// owns the object and frees it once the collector proves it unreachable.
+class HeapObject : public MemoryTracked<MEMORY_HEAP>
+{
+public:
+    HeapObject(HeapObjectType type) : type(type), marked(false) {}
+    virtual ~HeapObject() = default;
+
+    HeapObjectType getType() const { return type; }
+
+    // number of slots the collector has to scan
+    virtual size_t count() const = 0;
+    // shade the objects referenced by slots [from, from + budget), returns the next slot
+    virtual size_t trace(Heap &heap, size_t from, size_t budget) = 0;
+    // drop up to budget slots, returns what is left; the object is deleted at 0
+    virtual size_t shrink(size_t budget) = 0;
+
+    virtual std::string toString() const = 0;
+
+private:
+    friend class Heap;
+    HeapObjectType type;
+    bool marked;
+};
+
+class ListObject : public HeapObject
+{
+public:
+    ListObject() : HeapObject(HEAP_LIST) {}
+
+    std::vector<Literal, MemoryAllocator<Literal, MEMORY_HEAP>> items;
+
+    size_t count() const override { return items.size(); }
+    size_t trace(Heap &heap, size_t from, size_t budget) override;
+    size_t shrink(size_t budget) override;
+    std::string toString() const override;
+};
+
+class MapObject : public HeapObject
+{
+public:
+    MapObject() : HeapObject(HEAP_MAP) {}
+
+    Literal *get(const std::string &key);
+    void set(const std::string &key, const Literal &value);
+    bool remove(const std::string &key);
+    bool contains(const std::string &key) const { return index.find(key) != index.end(); }
+
+    size_t count() const override { return values.size(); }
+    size_t trace(Heap &heap, size_t from, size_t budget) override;
+    size_t shrink(size_t budget) override;
+    std::string toString() const override;
+
+private:
+    std::unordered_map<std::string, size_t, std::hash<std::string>, std::equal_to<std::string>,
+                       MemoryAllocator<std::pair<const std::string, size_t>, MEMORY_HEAP>> index;
+    std::vector<std::string, MemoryAllocator<std::string, MEMORY_HEAP>> keys;
+    std::vector<Literal, MemoryAllocator<Literal, MEMORY_HEAP>> values;
+};
+
+struct HeapStats
+{
+    size_t objects;
+    size_t allocated;
+    size_t freed;
+    size_t cycles;
+    size_t steps;
+    double lastPause;
+    double maxPause;
+    double totalPause;
+};
+
+// Incremental tri-color mark & sweep. Work is done in slices from step(),
+// each slice stops once the frame budget is spent, so a big structure is
+// traced and freed over several frames instead of one long pause.
+// Stores into a heap object go through barrier() while marking is active.
+class Heap
+{
+public:
+    enum Phase
+    {
+        IDLE,
+        MARK,
+        SWEEP,
+    };
+
+    Heap();
+    ~Heap();
+
+    ListObject *newList();
+    MapObject *newMap();
+
+    void shade(HeapObject *object);
+    void shade(const Literal &value);
+    void barrier(const Literal &value);
+
+    // bumped on every root scan, lets shared environments be scanned once
+    size_t epoch() const { return rootEpoch; }
+
+    void step();
+    void requestFull() { fullRequested = true; }
+    void clear();
+
+    void setBudget(double ms) { budget = ms; }
+    double getBudget() const { return budget; }
+    Phase getPhase() const { return phase; }
+
+    const HeapStats &getStats() const { return stats; }
+    double pausePercentile(double p) const;
+    void printStats() const;
+
+    std::function<void(Heap &)> markRoots;
+
+private:
+    struct GrayEntry
+    {
+        HeapObject *object;
+        size_t cursor;
+    };
+
+    void track(HeapObject *object);
+    void scanRoots();
+    bool mark(size_t &work);
+    bool sweep(size_t &work);
+    bool release(size_t &work);
+    bool expired() const;
+    void record(double ms);
+
+    std::vector<HeapObject *> objects;
+    std::vector<HeapObject *> dying;
+    std::vector<GrayEntry> gray;
+    Phase phase;
+    size_t sweepCursor;
+    size_t threshold;
+    size_t allocatedSinceCycle;
+    bool fullRequested;
+    bool unbounded;
+    double budget;
+    double stepStart;
+    size_t rootEpoch;
+
+    HeapStats stats;
+    std::vector<double> pauses;
+    size_t pauseIndex;
+};
@@ -0,0 +1,126 @@
+#pragma once
+#include <bitset>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+enum InputMode
+{
+    // the natives read raylib
+    INPUT_LIVE,
+    // like live, and every step's input is written to a tape
+    INPUT_RECORD,
+    // every step's input comes from a tape, raylib is never read
+    INPUT_REPLAY,
+    // no keyboard or mouse, every step reads an idle frame
+    INPUT_NONE
+};
+
+// What the input natives return during one simulation step.
+struct InputFrame
+{
+    static const int KeyCount = 512;
+
+    std::bitset<KeyCount> keysDown;
+    std::bitset<KeyCount> keysPressed;
+    std::bitset<KeyCount> keysReleased;
+    uint8_t buttonsDown;
+    uint8_t buttonsPressed;
+    uint8_t buttonsReleased;
+    float mouseX;
+    float mouseY;
+    std::vector<int> keys;
+    std::vector<int> chars;
+    // seconds of the step, and their sum since recording started
+    double delta;
+    double time;
+
+    InputFrame();
+    void clearEdges();
+};
+
+// Input of the engine loop. Poll() runs once per rendered frame and keeps
+// the presses it sees until the next simulation step, which may be several
+// frames later with a fixed step. Once the loop calls BeginStep() the
+// natives read the step's frame, the same one that goes to or comes from a
+// tape; before that they read raylib directly.
+//
+// A tape is a header and one record per step holding only what changed
+// since the step before, an idle step takes a single byte.
+//
+// Like the scene, a thread can bind an input of its own, a batch run gives
+// each script an idle one; without a binding Get() is the process wide one
+// the window feeds.
+class Input
+{
+public:
+    static const int ButtonCount = 8;
+
+    Input();
+
+    static Input &Get()
+    {
+        if (current)
+            return *current;
+        static Input input;
+        return input;
+    }
+    // returns the input bound before
+    static Input *Bind(Input *input)
+    {
+        Input *previous = current;
+        current = input;
+        return previous;
+    }
+
+    // false when the file can not be opened or is not a tape
+    bool Record(const std::string &path);
+    bool Replay(const std::string &path);
+    // for runs without a window
+    void Disable();
+    void Stop();
+    InputMode GetMode() const { return mode; }
+    // the replay ran past the last recorded step
+    bool Finished() const { return finished; }
+    size_t Steps() const { return steps; }
+
+    void Poll();
+    // delta is the step the loop runs, a replay uses the recorded one
+    void BeginStep(double delta);
+
+    bool KeyDown(int key) const;
+    bool KeyPressed(int key) const;
+    bool KeyReleased(int key) const;
+    bool MouseDown(int button) const;
+    bool MousePressed(int button) const;
+    bool MouseReleased(int button) const;
+    float MouseX() const;
+    float MouseY() const;
+    int GetKey();
+    int GetChar();
+    // -1 outside a step, the caller falls back to its own clock
+    double Delta() const;
+    double Time() const;
+
+private:
+    static thread_local Input *current;
+
+    void capture(double delta);
+    void write();
+    bool read();
+
+    InputMode mode;
+    bool stepping;
+    bool finished;
+    size_t steps;
+    // edges and queued keys seen by Poll() since the last step
+    InputFrame pending;
+    InputFrame frame;
+    // the last frame written or read, records hold the differences to it
+    InputFrame previous;
+    size_t nextKey;
+    size_t nextChar;
+    std::ofstream out;
+    std::ifstream in;
+};
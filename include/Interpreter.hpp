@@ -6,6 +6,11 @@
 #include "Utils.hpp"
 #include "Lexer.hpp"
 #include "Parser.hpp"
+#include "Heap.hpp"
+#include "Memory.hpp"
+#include "ProcessTable.hpp"
+#include "JobSystem.hpp"
+#include "TimerWheel.hpp"
 
 
 
@@ -23,10 +28,15 @@ using   LiteralList =  Literal*;
 typedef LiteralPtr (*NativeFunction)(ExecutionContext* ctx, int argc);
 typedef void (*GlobalScope)(ExecutionContext* ctx);
 
+// the native only reads engine state and touches the calling process,
+// processes limited to such natives may tick on worker threads
+const int NATIVE_LOCAL = 1;
+
 typedef struct 
 {
     const char* name;
     NativeFunction func;
+    int flags;
 } NativeFuncDef;
 
 class ReturnException : public std::runtime_error
@@ -50,6 +60,21 @@ public:
     explicit ContinueException() : std::runtime_error("Continue") {}
 };
 
+// what becomes of a process that runs past its tick budget
+enum TickBudgetMode
+{
+    BUDGET_SUSPEND,
+    BUDGET_KILL
+};
+
+// a process tick ran past its statement budget
+class BudgetException : public std::runtime_error
+{
+public:
+
+    explicit BudgetException() : std::runtime_error("Budget") {}
+};
+
 class FatalException : public std::runtime_error
 {
 public:
@@ -74,10 +99,36 @@ public:
     unsigned char      getByte(size_t index);
     std::string        getString(size_t index) ;
     bool               getBool(size_t index);
+    HeapObject        *getObject(size_t index);
+    Literal           *getLiteral(size_t index);
+
+    Heap *getHeap();
 
     Process *getCurrentProcess();
 
     Process *getInternalProcess();
+
+    // nullptr when the id is stale or the process is dead
+    Process *findProcess(long id);
+    size_t spawnMany(const std::string &name, size_t count, const std::vector<Literal> &arguments);
+    // signal() and send() from the current process, false on a stale id
+    bool signal(long id, int code, const Literal &value);
+    size_t signalType(const std::string &name, int code);
+    // process type of a name, -1 when no process has it
+    long typeIndex(const std::string &name);
+    Process *firstOfType(long type);
+    // get_id(): the next live process of a type for this caller, 0 past the last
+    long nextOfType(long type);
+    size_t countOfType(long type);
+    bool setTickRate(const std::string &name, double rate);
+    // returns the previous budget
+    double setFrameBudget(double ms);
+    bool setDeferrable(const std::string &name, bool deferrable);
+    // returns the previous budget
+    long setTickBudget(long statements, bool kill);
+    // the stream of the calling process, the main block has one of its own
+    Random &random();
+    uint64_t setRandomSeed(uint64_t seed);
    
 
     LiteralPtr  asFloat(double value) ;
@@ -86,6 +137,8 @@ public:
     LiteralPtr  asString(const std::string &value);
     LiteralPtr  asString(const char *value);
     LiteralPtr  asBool(bool value);
+    LiteralPtr  asObject(HeapObject *value);
+    LiteralPtr  asLiteral(const Literal &value);
 
     bool define_int(const std::string &name, long value);
     bool define_float(const std::string &name, double value);
@@ -136,6 +189,8 @@ public:
     virtual std::shared_ptr<Expr> visitNowExpr(NowExpr *expr) = 0; // current time
 
     virtual std::shared_ptr<Expr> visitAssignExpr(AssignExpr *expr) = 0;
+    virtual std::shared_ptr<Expr> visitFieldExpr(FieldExpr *expr) = 0;
+    virtual std::shared_ptr<Expr> visitFieldAssignExpr(FieldAssignExpr *expr) = 0;
 
     virtual std::shared_ptr<Expr> visitVariableExpr(VariableExpr *expr) = 0;
 
@@ -169,6 +224,7 @@ public:
     virtual void visitProcedureCallStmt(ProcedureCallStmt *stmt) = 0;
 
     virtual void visitProcessStmt(ProcessStmt *stmt) = 0;
+    virtual void visitFrameStmt(FrameStmt *stmt) = 0;
 
     
 };
@@ -177,43 +233,113 @@ public:
 
 
 
+// Free list of fixed size blocks. The blocks are handed to allocate_shared,
+// so a literal and its control block come out of one recycled block.
+// A pool belongs to the thread that made it, a block released on any other
+// thread goes to a locked list its owner takes back on a miss. When the
+// owner goes away the pool is orphaned and deletes itself once the last
+// block still out comes back.
+class LiteralPool
+{
+public:
+    LiteralPool(const char *name, size_t maxFree);
+
+    void *acquire(size_t size);
+    void release(void *block, size_t size);
+    void clear();
+    void orphan();
+
+    double hitRate() const;
+
+    const char *name;
+    size_t blockSize;
+    size_t maxFree;
+    size_t hits;
+    size_t misses;
+    std::atomic<size_t> live;
+    size_t highWater;
+
+private:
+    ~LiteralPool();
+
+    void releaseRemote(void *block, size_t size);
+    void dispose(void *block, size_t size);
+
+    std::vector<void *> freeList;
+    std::thread::id owner;
+    std::atomic<bool> orphaned;
+    std::mutex remoteLock;
+    std::vector<void *> remote;
+    std::atomic<bool> remotePending;
+};
+
+template <typename T>
+struct PoolAllocator
+{
+    typedef T value_type;
+
+    LiteralPool *pool;
+
+    PoolAllocator(LiteralPool *pool) : pool(pool) {}
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U> &other) : pool(other.pool) {}
+
+    T *allocate(size_t n) { return static_cast<T *>(pool->acquire(n * sizeof(T))); }
+    void deallocate(T *p, size_t n) { pool->release(p, n * sizeof(T)); }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U> &other) const { return pool == other.pool; }
+    template <typename U>
+    bool operator!=(const PoolAllocator<U> &other) const { return pool != other.pool; }
+};
+
     class Factory
     {
     private:
         Factory();
         ~Factory();
 
-     std::vector<std::shared_ptr<LiteralExpr>> intPool;
-     std::vector<std::shared_ptr<LiteralExpr>> floatPool;
-     std::vector<std::shared_ptr<LiteralExpr>> boolPool;
-     std::vector<std::shared_ptr<LiteralExpr>> stringPool;
-     std::vector<std::shared_ptr<LiteralExpr>> bytePool;
+     LiteralPool *intPool;
+     LiteralPool *floatPool;
+     LiteralPool *boolPool;
+     LiteralPool *stringPool;
+     LiteralPool *bytePool;
+     LiteralPool *objectPool;
+     LiteralPool *literalPool;
      
-    size_t MaxPool = 100;
+    static const size_t MaxPool = 1024;
 
 
     public:
+        // one per thread, a literal freed on another thread or after its
+        // thread ended still goes back to the pool it came from
         static Factory &Instance()
         {
-            static Factory instance;
+            static thread_local Factory instance;
             return instance;
         }
 
-        void release(std::shared_ptr<Literal> literal);
+        void release(std::shared_ptr<Literal> &literal);
 
         std::shared_ptr<Literal> acquireInteger(long value);
         std::shared_ptr<Literal> acquireFloat(double value);
         std::shared_ptr<Literal> acquireByte(unsigned char value);
         std::shared_ptr<Literal> acquireBool(bool value);
         std::shared_ptr<Literal> acquireString(const std::string &value);
+        std::shared_ptr<Literal> acquireObject(HeapObject *value);
+        std::shared_ptr<Literal> acquire(const Literal &value);
 
         void clear();
+        void printStats() const;
 
         std::shared_ptr<LiteralExpr> createIntegerLiteral(long value);
         std::shared_ptr<LiteralExpr> createFloatLiteral(double value);
         std::shared_ptr<LiteralExpr> createByteLiteral(unsigned char value);
         std::shared_ptr<LiteralExpr> createStringLiteral(const std::string &value);
         std::shared_ptr<LiteralExpr> createBoolLiteral(bool value);
+        std::shared_ptr<LiteralExpr> createObjectLiteral(HeapObject *value);
+        std::shared_ptr<LiteralExpr> createLiteral(const Literal &value);
 
 
 
@@ -224,9 +350,14 @@ class Environment
 {
 
 private:
-    std::unordered_map<std::string, Literal> m_values;
+    typedef std::pair<const std::string, Literal> Binding;
+    std::unordered_map<std::string, Literal, std::hash<std::string>, std::equal_to<std::string>,
+                       MemoryAllocator<Binding, MEMORY_INTERPRETER>> m_values;
+    // process built-ins in processLocals[] order, empty for other scopes
+    std::vector<Literal, MemoryAllocator<Literal, MEMORY_INTERPRETER>> m_builtins;
  
     unsigned int m_depth;
+    size_t m_epoch;
     std::shared_ptr<Environment> m_parent;
 
 public:
@@ -237,6 +368,8 @@ public:
     bool define(const std::string &name,const  Literal &value);
 
     Literal *get(const std::string &name);
+    // this scope only, without the built-ins and the parents
+    Literal *local(const std::string &name);
 
     void set(const std::string &name, long value);
     void set(const std::string &name, double value);
@@ -261,15 +394,73 @@ public:
     bool addString(const std::string &name, const std::string &value);
 
 
-    unsigned int count() const { return m_values.size(); }
+    unsigned int count() const { return m_values.size() + m_builtins.size(); }
+
+    // fixed slots for the process built-ins, looked up before the parent
+    void setBuiltins(const std::vector<Literal> &values);
+    bool hasBuiltins() const { return !m_builtins.empty(); }
+    // the built-in slot a value lives in, -1 when it is not one of them
+    int builtinSlot(const Literal *value) const
+    {
+        const Literal *first = m_builtins.data();
+        return value >= first && value < first + m_builtins.size() ? (int)(value - first) : -1;
+    }
+    Literal &builtin(int slot) { return m_builtins[slot]; }
 
     unsigned int getDepth() const { return m_depth; }
 
+    // take the bindings of defaults and a new place in the scope chain,
+    // reusing the nodes of the old bindings
+    void reset(int depth, std::shared_ptr<Environment> parent, const Environment &defaults);
+
+    void mark(Heap &heap);
+
 
 
 };
 
 
+// Interpreter state of one thread of execution. The main thread runs on the
+// interpreter's own, each worker ticking processes in parallel has one.
+struct ExecutionState
+{
+    std::stack<std::shared_ptr<Environment>> environmentStack;
+    unsigned int currentDepth{0};
+    uintptr_t addressLoop{0};
+    std::shared_ptr<ExecutionContext> context;
+    // statements run by the process being ticked, 0 limit when unbudgeted
+    long steps{0};
+    long stepLimit{0};
+    size_t preempted{0};
+    size_t budgetKills{0};
+};
+
+// Dead processes of one type waiting to be spawned again, with their locals.
+struct ProcessPool
+{
+    std::vector<std::unique_ptr<Process>> free;
+    size_t created;
+    size_t reused;
+};
+
+struct SchedulerStats
+{
+    size_t ticks;
+    // processes passed over because an earlier frame(n) covered this frame
+    size_t skipped;
+    size_t parallelTicks;
+    size_t segments;
+    size_t steals;
+    // sleepers taken off the timer wheels
+    size_t woken;
+    // deferrable ticks put off to a later frame by the frame budget
+    size_t deferred;
+    size_t frames;
+    size_t overBudget;
+    double totalFrame;
+    double maxFrame;
+};
+
 class Interpreter : public Visitor
 {
 public:
@@ -290,6 +481,8 @@ public:
     std::shared_ptr<Expr> visitEmptyExpr(EmptyExpr *expr);
     std::shared_ptr<Expr> visitVariableExpr(VariableExpr *expr);//read
     std::shared_ptr<Expr> visitAssignExpr(AssignExpr *expr);//write
+    std::shared_ptr<Expr> visitFieldExpr(FieldExpr *expr);
+    std::shared_ptr<Expr> visitFieldAssignExpr(FieldAssignExpr *expr);
     
     std::shared_ptr<Expr> visitCallerFunctionExpr(CallerExpr *expr);
 
@@ -297,6 +490,26 @@ public:
     std::shared_ptr<Expr> callNativeFunction(CallerExpr *expr);
     std::shared_ptr<Expr> callFunction(CallerExpr *expr);
     std::shared_ptr<Expr> callProcess(CallerExpr *expr) ;
+    // spawn count processes of one type with the same arguments, a list given
+    // for a parameter that is not var hands out one item per process;
+    // returns how many were spawned
+    size_t spawnMany(const std::string &typeName, size_t count, const std::vector<Literal> &arguments,
+                     std::vector<long> *ids = nullptr);
+    // queue a signal or a send() value for a process, kill and wakeup also
+    // reach a process sleeping on a timer wheel
+    void signalProcess(Process *process, int signal, const Literal &value, long sender);
+    // the process and every live process under it in the spawn tree
+    void signalTree(Process *root, int signal, long sender);
+    // every live process of a type, returns how many got the signal
+    size_t signalType(const std::string &typeName, int signal, long sender);
+
+    long typeIndex(const std::string &typeName) const;
+    Process *firstOfType(long type) const { return type < 0 ? nullptr : processes.firstOfType((size_t)type); }
+    // the caller keeps its own position, nullptr for the main block
+    long nextOfType(long type, Process *caller);
+    size_t countOfType(long type) const;
+    // tick_rate of a type, for its live processes and the ones spawned later
+    bool setTickRate(const std::string &typeName, double rate);
 
 
     void visitPrintStmt(PrintStmt *stmt);
@@ -321,6 +534,7 @@ public:
     void visitProcedureStmt(ProcedureStmt *stmt);
     void visitFunctionStmt(FunctionStmt *stmt);
     void visitProcessStmt(ProcessStmt *stmt) ;
+    void visitFrameStmt(FrameStmt *stmt);
 
     
     bool isTruthy(const std::shared_ptr<Expr> &expr);
@@ -356,24 +570,49 @@ public:
 
     bool Equal(LiteralExpr *a, LiteralExpr *b);
 
-    bool processInitExecute(size_t index);
-    bool processEndExecute(size_t index);
-    bool processLoopExecute(size_t index);
+    bool resumeProcess(Process *process);
 
-    void registerFunction(const std::string &name, NativeFunction function);
+    void registerFunction(const std::string &name, NativeFunction function, int flags = 0);
     void registerGlobalScope(GlobalScope function);
 
-    std::stack<std::shared_ptr<Environment>> environmentStack;
-
-    size_t Count() const { return processes.size(); }
+    // worker threads for process ticks, counting the calling thread
+    void setThreads(size_t count);
+    size_t getThreads() const { return jobs.workers(); }
+    const SchedulerStats &getSchedulerStats() const { return schedulerStats; }
+    void printSchedulerStats() const;
+    // ms a frame may spend ticking before deferrable processes wait for the
+    // next one, 0 ticks everything every frame
+    void setFrameBudget(double ms) { frameBudget = std::max(0.0, ms); }
+    double getFrameBudget() const { return frameBudget; }
+    bool setDeferrable(const std::string &typeName, bool deferrable);
+    // statements a process may run per tick before it is preempted and
+    // carries on next frame, or killed with kill set; 0 has no limit
+    void setTickBudget(long statements, bool kill) { tickBudget = std::max(0L, statements); budgetKill = kill; }
+    long getTickBudget() const { return tickBudget; }
+    // seconds of game time every run() stands for; sleep(ms) and tick_rate
+    // then follow that clock instead of the host's, 0 uses the wall clock
+    void setFixedStep(double seconds) { fixedStep = std::max(0.0, seconds); }
+    double getFixedStep() const { return fixedStep; }
+    double framePercentile(double p) const;
+    const ProcessPool *getProcessPool(const std::string &name) const;
+    void printPoolStats() const;
+
+    size_t Count() const { return processes.size() + processes.sleeping(); }
+    size_t Sleeping() const { return processes.sleeping(); }
+    Process *findProcess(long id) const { return processes.find(id); }
     
-    ExecutionContext *getContext() { return context.get(); }
+    ExecutionContext *getContext() { return state().context.get(); }
+    Heap &getHeap() { return heap; }
+    // bound to the thread that called init() and to the worker threads
+    Scene &getScene() { return *scene; }
+    // processes spawned afterwards and the main block draw from streams of this seed
+    void setRandomSeed(uint64_t seed);
+    uint64_t getRandomSeed() const { return randomSeed; }
+    Random &mainRandom() { return mainStream; }
 private:
     friend class Parser;
     friend class Process;
     bool panicMode;
-    unsigned int currentDepth;
-    uintptr_t addressLoop;
     unsigned long BlockID;
     std::shared_ptr<Stmt> program;
     Lexer lexer;
@@ -381,10 +620,77 @@ private:
 
 
     std::shared_ptr<Environment> mainEnvironment;
-    std::shared_ptr<ExecutionContext> context;
+    ExecutionState mainState;
+    std::vector<std::unique_ptr<ExecutionState>> workerStates;
+    static thread_local ExecutionState *activeState;
+    JobSystem jobs;
+    SchedulerStats schedulerStats;
     std::chrono::high_resolution_clock::time_point start_time;
-    std::vector<std::unique_ptr<Process>> processes;
-    std::vector<std::unique_ptr<Process>> remove_processes;
+    ProcessTable processes;
+    TimerWheel frameWheel;
+    TimerWheel timeWheel;
+    int64_t frameNumber;
+    // time_elapsed() when the frame started, for the frame budget
+    double frameTime;
+    // ms of game time at the start of the frame, the clock of the ms wheel
+    double gameTime;
+    double fixedStep;
+    double frameBudget;
+    // deferrable processes of this frame, in table order
+    std::vector<Process *> deferQueue;
+    // spawn sequence of the first process the budget passed over
+    uint64_t deferFrom;
+    std::vector<double> frameTimes;
+    long tickBudget;
+    bool budgetKill;
+    std::vector<long> expired;
+    std::vector<Process *> sleepers;
+    // sleepers sent s_wakeup, taken off their wheel at the next frame
+    std::vector<long> interrupted;
+    // get_id() position of the main block
+    TypeCursor mainCursor;
+    std::vector<ProcessPool> processPools;
+    // built-in locals every process starts with
+    std::shared_ptr<Environment> processDefaults;
+    Heap heap;
+    std::unique_ptr<Scene> scene;
+    uint64_t randomSeed;
+    Random mainStream;
+
+    void markRoots(Heap &heap);
+
+    ExecutionState &state() { return activeState ? *activeState : mainState; }
+    void countStep()
+    {
+        ExecutionState &exec = state();
+        if (exec.stepLimit > 0 && ++exec.steps > exec.stepLimit)
+        {
+            throw BudgetException();
+        }
+    }
+
+    std::unique_ptr<Process> acquireProcess(size_t index, const std::string &name, long id);
+    std::unique_ptr<Process> createProcess(size_t index, const std::string &name, long id);
+    void recycleProcess(std::unique_ptr<Process> process);
+    // father, son, bigbro and smallbro of a new process and its family
+    void adopt(Process *process);
+    Literal *processField(FieldExpr *expr, Process **owner = nullptr);
+    void wakeSleepers();
+    void parkSleepers();
+    void tickProcess(Process *process, ExecutionContext *context);
+    size_t parallelSegment(size_t begin) const;
+    void tickParallel(size_t begin, size_t end);
+    void tickDeferred(ExecutionContext *context);
+    void recordFrame(double ms);
+    void classifyProcesses();
+    bool parallelSafe(Stmt *stmt, std::unordered_set<std::string> &locals);
+    bool parallelSafe(Expr *expr, std::unordered_set<std::string> &locals);
+    bool parallelSafeCall(Stmt *callee, const std::vector<std::shared_ptr<Argument>> &parameter);
+
+    Stmt *selectBranch(IfStmt *stmt);
+    Stmt *selectCase(SwitchStmt *stmt);
+    bool enterFrame(Process *process, Stmt *stmt, bool implicitFrame);
+    bool stepFrame(Process *process, bool implicitFrame);
 
 
     double time_elapsed();
@@ -437,6 +743,8 @@ private:
     std::unordered_map<std::string, size_t> processListNames;
 
     std::unordered_map<std::string, NativeFunction> nativeFunctions;
+    std::unordered_set<std::string> localNatives;
+    std::unordered_map<const Stmt *, bool> safeCalls;
 
     std::vector<Literal*> native_args;
     std::vector<std::shared_ptr<ProcessExecution>> processExecuter;
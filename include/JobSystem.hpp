@@ -0,0 +1,70 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of worker threads with one range queue per worker. A worker
+// pops from the back of its own queue and steals from the front of the
+// others once it runs dry. The thread calling parallelFor() works as
+// worker 0 and returns when every range is done.
+class JobSystem
+{
+public:
+    typedef std::function<void(size_t begin, size_t end, size_t worker)> RangeJob;
+
+    JobSystem();
+    ~JobSystem();
+
+    // threads counts the calling thread, 1 or less runs everything inline
+    void start(size_t threads);
+    void stop();
+
+    size_t workers() const { return queues.empty() ? 1 : queues.size(); }
+
+    // split [0, count) in ranges of grain items, the first exception thrown
+    // by a range is rethrown here once all ranges finished
+    void parallelFor(size_t count, size_t grain, const RangeJob &job);
+
+    size_t getSteals() const { return steals.load(std::memory_order_relaxed); }
+
+private:
+    struct Range
+    {
+        size_t begin;
+        size_t end;
+    };
+
+    struct Queue
+    {
+        std::mutex lock;
+        std::deque<Range> ranges;
+    };
+
+    void workerLoop(size_t worker);
+    bool pop(size_t worker, Range &range);
+    bool steal(size_t worker, Range &range);
+    void runRanges(size_t worker, const RangeJob &job);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+
+    std::mutex wakeLock;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const RangeJob *job;
+    size_t generation;
+    size_t busy;
+    bool quit;
+
+    std::atomic<size_t> pending;
+    std::atomic<size_t> steals;
+
+    std::mutex failureLock;
+    std::exception_ptr failure;
+};
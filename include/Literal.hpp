@@ -4,6 +4,8 @@
 #include <unordered_map>
 #include "Token.hpp"
 
+class HeapObject;
+
 enum LiteralType
 {
     STRING,
@@ -11,6 +13,7 @@ enum LiteralType
     FLOAT, 
     BYTE,
     BOOLEAN,
+    OBJECT,
     UNDEFINED
 };
 
@@ -18,7 +21,7 @@ class Literal
 {
 private:
     LiteralType type;
-     using LiteralValue = std::variant<double, long, bool, unsigned char, std::string>;
+     using LiteralValue = std::variant<double, long, bool, unsigned char, std::string, HeapObject *>;
      LiteralValue value;
 
 
@@ -29,8 +32,14 @@ public:
     Literal(bool v);
     Literal(unsigned char v);
     Literal(const std::string &v);
+    Literal(HeapObject *v);
     ~Literal();
 
+    // zero value of a declared slot type
+    static Literal slot(LiteralType type);
+    // true when a value of type 'from' can be stored in a slot of type 'to'
+    static bool convertible(LiteralType from, LiteralType to);
+
 
  
     std::string     getString() const;
@@ -38,12 +47,14 @@ public:
     bool            getBool() const;
     unsigned char   getByte() const;
     long            getInt() const;
+    HeapObject     *getObject() const;
 
     void setString(const std::string &v);
     void setFloat( double v);
     void setBool( bool v);
     void setByte( unsigned char v);
     void setInt( long v);
+    void setObject(HeapObject *v);
 
     bool isTruthy() const;
     bool isEqual(const Literal &other) const;
@@ -54,6 +65,7 @@ public:
     bool isByte() const { return type == BYTE; }
     bool isBool() const { return type == BOOLEAN; }
     bool isString() const { return type == STRING; }
+    bool isObject() const { return type == OBJECT; }
 
 
 
@@ -66,6 +78,9 @@ public:
     bool assign(const Literal &other);
     bool assign(Literal *other);
 
+    // raw copy into a slot of the same type, no conversion
+    void store(const Literal &other) { value = other.value; }
+
     void print();
 
     LiteralType getType() const { return type; }
@@ -0,0 +1,64 @@
+#pragma once
+#include <atomic>
+#include "Literal.hpp"
+
+// signal() codes, SIGNAL_NONE carries a send() value. SIGNAL_TREE added
+// to a code sends it to the process and everything it spawned.
+enum ProcessSignal
+{
+    SIGNAL_NONE,
+    SIGNAL_KILL,
+    SIGNAL_WAKEUP,
+    SIGNAL_SLEEP,
+    SIGNAL_FREEZE,
+    SIGNAL_TREE = 16
+};
+
+struct Message
+{
+    int signal;
+    Literal value;
+    long sender;
+};
+
+// Intrusive multi producer, single consumer queue (Vyukov). Any thread may
+// post, only the owning process takes, at the start of its tick. A post is
+// one allocation and one atomic exchange, a take never waits on a producer.
+class Mailbox
+{
+public:
+    Mailbox();
+    ~Mailbox();
+
+    Mailbox(const Mailbox &) = delete;
+    Mailbox &operator=(const Mailbox &) = delete;
+
+    void post(const Message &message);
+    // false when empty, or when a post is half way through
+    bool take(Message &message);
+    void clear();
+
+    // walks the queued messages, only while nobody posts or takes
+    template <typename F>
+    void forEach(F f) const
+    {
+        for (Node *node = tail; node; node = node->next.load(std::memory_order_acquire))
+        {
+            if (node != &stub)
+                f(node->message);
+        }
+    }
+
+private:
+    struct Node
+    {
+        std::atomic<Node *> next;
+        Message message;
+    };
+
+    void push(Node *node);
+
+    std::atomic<Node *> head;
+    Node *tail;
+    Node stub;
+};
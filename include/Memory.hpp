@@ -0,0 +1,100 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+enum MemoryTag
+{
+    MEMORY_INTERPRETER,
+    MEMORY_AST,
+    MEMORY_LITERAL,
+    MEMORY_HEAP,
+    MEMORY_SCENE,
+    MEMORY_TEXTURE,
+    MEMORY_TAGS,
+};
+
+struct MemoryStats
+{
+    size_t current;
+    size_t peak;
+    size_t allocations;
+    size_t frees;
+    // allocations and bytes requested during the last finished frame
+    size_t frameAllocations;
+    size_t frameBytes;
+};
+
+// Tagged allocation counters. Each subsystem reports what it takes from
+// and gives back to the system, counters are atomic so any thread may
+// report. nextFrame() closes the per-frame window.
+class Memory
+{
+public:
+    static void alloc(MemoryTag tag, size_t bytes);
+    static void free(MemoryTag tag, size_t bytes);
+
+    static MemoryStats stats(MemoryTag tag);
+    static size_t current();
+    static size_t peak();
+
+    static void nextFrame();
+
+    static const char *tagName(MemoryTag tag);
+    // -1 when the name is not a tag
+    static int findTag(const std::string &name);
+
+    static void printStats();
+};
+
+// Class scoped operator new/delete that reports to a tag, for objects
+// created with plain new.
+template <MemoryTag Tag>
+struct MemoryTracked
+{
+    static void *operator new(size_t size)
+    {
+        Memory::alloc(Tag, size);
+        return ::operator new(size);
+    }
+
+    static void operator delete(void *block, size_t size)
+    {
+        Memory::free(Tag, size);
+        ::operator delete(block);
+    }
+};
+
+// Allocator for containers whose storage should count against a tag.
+template <typename T, MemoryTag Tag>
+struct MemoryAllocator
+{
+    typedef T value_type;
+
+    template <typename U>
+    struct rebind
+    {
+        typedef MemoryAllocator<U, Tag> other;
+    };
+
+    MemoryAllocator() = default;
+
+    template <typename U>
+    MemoryAllocator(const MemoryAllocator<U, Tag> &) {}
+
+    T *allocate(size_t n)
+    {
+        Memory::alloc(Tag, n * sizeof(T));
+        return static_cast<T *>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T *block, size_t n)
+    {
+        Memory::free(Tag, n * sizeof(T));
+        ::operator delete(block);
+    }
+
+    template <typename U>
+    bool operator==(const MemoryAllocator<U, Tag> &) const { return true; }
+    template <typename U>
+    bool operator!=(const MemoryAllocator<U, Tag> &) const { return false; }
+};
@@ -2,12 +2,57 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <type_traits>
 #include "Token.hpp"
 #include "Literal.hpp"
 #include "Exp.hpp"
 #include "Stm.hpp"
+#include "Arena.hpp"
 
 
+// locals every process instance starts with, kept in fixed slots of the
+// process environment instead of its map, see Environment::builtin
+struct ProcessLocal
+{
+    const char *name;
+    LiteralType type;
+    double initial;
+};
+
+extern const ProcessLocal processLocals[];
+
+// slot of each entry of processLocals[]
+enum ProcessLocalSlot
+{
+    LOCAL_ID,
+    LOCAL_GRAPH,
+    LOCAL_LAYER,
+    LOCAL_X,
+    LOCAL_Y,
+    LOCAL_ANGLE,
+    LOCAL_SCALE_X,
+    LOCAL_SCALE_Y,
+    LOCAL_SKEW_X,
+    LOCAL_SKEW_Y,
+    LOCAL_RED,
+    LOCAL_GREEN,
+    LOCAL_BLUE,
+    LOCAL_ALPHA,
+    LOCAL_SHOW_BOX,
+    LOCAL_SHOW_PIVOT,
+    LOCAL_ACTIVE,
+    LOCAL_VISIBLE,
+    LOCAL_FATHER,
+    LOCAL_SON,
+    LOCAL_BIGBRO,
+    LOCAL_SMALLBRO,
+    LOCAL_TICK_RATE,
+    LOCAL_COUNT
+};
+
+// slot of a built-in local, -1 for any other name
+int processLocalSlot(const std::string &name);
+
 class Parser
 {
 public:
@@ -29,7 +74,35 @@ private:
     bool panicMode;
     int countBegins;
     int countEnds ;
-
+    std::shared_ptr<Arena> arena;
+    // numbers the statements of one parse, each parser has its own count
+    unsigned long statementID;
+
+    // declared slot types, innermost scope last
+    std::vector<std::unordered_map<std::string, LiteralType>> scopes;
+    // names used as fields of a process that are not built-ins
+    std::unordered_map<std::string, int> fieldIds;
+    std::vector<ProcessStmt *> processes;
+
+    void beginScope();
+    void endScope();
+    void declare(const std::string &name, LiteralType type);
+    void declare(const std::vector<std::shared_ptr<Argument>> &parameter);
+    LiteralType resolve(const std::string &name);
+    int fieldId(const std::string &name);
+    void resolveFields();
+    std::shared_ptr<Expr> fold(std::shared_ptr<Expr> value, LiteralType type, const Token &name);
+
+    template <typename T, typename... Args>
+    std::shared_ptr<T> create(Args &&...args)
+    {
+        std::shared_ptr<T> node = std::allocate_shared<T>(ArenaAllocator<T>(arena), std::forward<Args>(args)...);
+        if constexpr (std::is_base_of<Stmt, T>::value)
+        {
+            node->ID = statementID++;
+        }
+        return node;
+    }
 
 
 
@@ -55,6 +128,7 @@ private:
      std::shared_ptr<Expr> comparison();
      std::shared_ptr<Expr> assignment();
 
+     std::shared_ptr<Expr> fieldAssignment(std::shared_ptr<FieldExpr> field);
      std::shared_ptr<Expr> logic_or();
      std::shared_ptr<Expr> logic_and();
      std::shared_ptr<Expr> logic_xor();
@@ -101,6 +175,7 @@ private:
      std::shared_ptr<LoopStmt> loopStmt();
      std::shared_ptr<BreakStmt> breakStmt();
      std::shared_ptr<ContinueStmt> continueStmt();
+     std::shared_ptr<FrameStmt> frameStmt();
 
      std::shared_ptr<ProcedureStmt> procedureStmt();     // declaration of procedure
      std::shared_ptr<ProcedureCallStmt> procedureCall(); // call of procedure
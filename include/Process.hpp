@@ -1,6 +1,10 @@
 #pragma once
 #include "Token.hpp"
 #include "Literal.hpp"
+#include "Memory.hpp"
+#include "Mailbox.hpp"
+#include "Random.hpp"
+#include <deque>
 
 #if defined(USE_GRAPHICS) 
 #include "Core.hpp" 
@@ -17,19 +21,47 @@ struct ProcessExecution
 {
     long index;
     std::string name;
-    std::vector<std::shared_ptr<Stmt>> initialStatements;
-    std::vector<BlockStmt*>            loopStatements;
-    std::vector<std::shared_ptr<Stmt>> finalStatements;
+    BlockStmt *body;
+    // the body has no frame statement, each pass of a top level loop ends the frame
+    bool implicitFrame;
+    // only touches its own locals and instance, may tick on a worker thread
+    bool parallel;
+    // ticks per second new processes of the type start with, 0 is every frame
+    double tickRate;
+    // may be put off to the next frame when the frame budget runs out
+    bool deferrable;
+    // from the declaration: the locals other processes can reach as fields
+    // and the local of each field id of the program, -1 where there is none
+    std::vector<std::string> locals;
+    std::vector<int> fields;
     ProcessExecution() = default;
-    ~ProcessExecution()
-    {
-        initialStatements.clear();
-        loopStatements.clear();
-        finalStatements.clear();
-    }
 };
 
-class Process
+// Saved position of a suspended process: one entry per block or loop the
+// frame statement is nested in, outermost first.
+struct ProcessFrame
+{
+    Stmt *stmt;
+    size_t pc;
+    std::shared_ptr<Environment> env;
+};
+
+// where get_id(type) left off for one caller
+struct TypeCursor
+{
+    long type;
+    long last;
+};
+
+// clock a sleeping process waits on
+enum ProcessClock
+{
+    CLOCK_NONE,
+    CLOCK_FRAMES,
+    CLOCK_MILLIS
+};
+
+class Process : public MemoryTracked<MEMORY_INTERPRETER>
 
 {
 
@@ -39,17 +71,77 @@ class Process
     Interpreter *interpreter;
     
     size_t index;
-    int state;
+    std::vector<ProcessFrame> frames;
+    bool started;
+    // percent of frame time left, every frame adds 100 and every frame(n)
+    // the process passes takes n; it runs while the credit is positive
+    long frameCredit;
+    long framePercent;
+    // sleep() and wait_frames() only mark the process, the scheduler moves it
+    // to a timer wheel once the frame is over and leaves it there until due
+    int sleepClock;
+    int64_t wakeAt;
+    // due time in ms of the next tick of a process with a tick_rate, -1 before the first
+    double nextTick;
+    bool parked;
+    uint64_t sequence;
+    // s_sleep or s_freeze, the scheduler passes the process over until s_wakeup
+    int signalState;
+    Mailbox mailbox;
+    // send() values already taken from the mailbox, waiting for receive()
+    std::deque<Message> inbox;
+    long lastSender;
+    // links in the list of processes of the same type, kept by ProcessTable
+    Process *typePrev;
+    Process *typeNext;
+    TypeCursor cursor;
+    // the processes it spawned that are still alive, kept by ProcessTable;
+    // parent is the spawning process
+    Process *firstChild;
+    Process *lastChild;
+    Process *prevSibling;
+    Process *nextSibling;
+    // seeded from the interpreter's seed and the id
+    Random random;
+    // built-ins written since the instance last took them, a bit per slot
+    uint32_t dirty;
+    // the locals of the type once defined, in ProcessExecution::locals order;
+    // null until the body gets to the declaration
+    std::vector<Literal *> fields;
+    void takeMessages();
+    void leaveParent();
+    void pace();
     friend class Interpreter;
+    friend class ProcessTable;
 
 public:
     Process(Interpreter *i,const std::string &name, long ID,size_t index);
 
     virtual ~Process();
 
-    void run();
+    // back to a fresh spawn of the same type under a new id
+    void reset(long ID);
+
+    // false when the process had no credit and was skipped this frame
+    bool run();
+    void kill();
+    void sleep(double ms);
+    void wait_frames(long frames);
+    bool sleeping() const { return sleepClock != CLOCK_NONE; }
+    Random &getRandom() { return random; }
+    // queue a signal or a send() value, both are taken when the next tick starts
+    void post(int signal, const Literal &value, long sender);
+    bool receive(Literal &value);
+    size_t messages() const { return inbox.size(); }
+    long sender() const { return lastSender; }
+    Process *nextOfType() const { return typeNext; }
+    Process *firstSon() const { return firstChild; }
+    Process *nextBrother() const { return nextSibling; }
+    size_t typeIndex() const { return index; }
     void pre_run();
     void post_run();
+    // a built-in was written, pre_run only hands the marked ones to the instance
+    void touch(int slot) { dirty |= 1u << slot; }
 
 
     void render();
@@ -64,6 +156,11 @@ public:
     void advance(double speed);
     void xadvance(double speed,double angle);
     void rotate_to(double target_angle, double t);
+    // position and angle as the script sees them, ahead of the instance
+    // until the tick ends
+    double getX() const;
+    double getY() const;
+    double getAngle() const;
 
    
     long graph;
@@ -0,0 +1,112 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+class Process;
+
+// Slot map owning the live processes. An id packs the slot index and the
+// slot generation, a slot is reused only with a new generation so an old
+// id held by a script resolves to nothing instead of to a newer process.
+// Awake processes are iterated densely in spawn order; dead and sleeping
+// ones are unlinked in one pass by reap() at the end of the frame. A
+// sleeping process keeps its slot until wake() merges it back in order.
+// Every process is also linked into the list of its type, so the processes
+// of one type are walked without looking at any other, and under the
+// process that spawned it. When a process is freed its children move up to
+// its parent, so a subtree stays reachable from the root.
+class ProcessTable
+{
+public:
+    static const int IndexBits = 20;
+    static const long IndexMask = (1L << IndexBits) - 1;
+
+    ProcessTable();
+    ~ProcessTable();
+
+    // reserve a slot, the id is never 0
+    long allocate();
+    // give back an id whose process was never inserted
+    void release(long id);
+    // take ownership of a process built with an id from allocate()
+    void insert(std::unique_ptr<Process> process);
+    // room for count more processes without growing mid batch
+    void reserve(size_t count);
+
+    // nullptr when the id is stale or the process has finished
+    Process *find(long id) const;
+    // like find, but also a process killed this frame that reap has not freed
+    Process *lookup(long id) const;
+    bool exists(long id) const { return find(id) != nullptr; }
+
+    // awake processes, the ones the scheduler ticks
+    size_t size() const { return dense.size(); }
+    size_t sleeping() const { return asleep; }
+    Process *at(size_t i) const { return dense[i]; }
+
+    std::vector<Process *>::const_iterator begin() const { return dense.begin(); }
+    std::vector<Process *>::const_iterator end() const { return dense.end(); }
+
+    // free every process that stopped running and move the ones that went
+    // to sleep this frame out of the awake list into parked
+    size_t reap(std::vector<Process *> &parked);
+    // put sleeping processes back in the awake list, in spawn order
+    void wake(std::vector<Process *> &woken);
+    // a sleeping process was killed, free it with the next reap
+    void bury(Process *process);
+    void clear();
+
+    // processes of a type in spawn order, follow Process::nextOfType; the
+    // ones killed this frame stay linked until reap frees them
+    Process *firstOfType(size_t type) const { return type < registries.size() ? registries[type].first : nullptr; }
+    size_t linkedOfType(size_t type) const { return type < registries.size() ? registries[type].size : 0; }
+
+    template <typename F>
+    void forEach(F f) const
+    {
+        for (const Slot &slot : slots)
+        {
+            if (slot.process)
+                f(slot.process.get());
+        }
+    }
+
+    size_t capacity() const { return slots.size(); }
+
+    // takes the processes reap() frees, they are destroyed when unset
+    std::function<void(std::unique_ptr<Process>)> recycle;
+
+private:
+    struct Slot
+    {
+        std::unique_ptr<Process> process;
+        uint32_t generation;
+    };
+
+    static size_t slotOf(long id) { return (size_t)(id & IndexMask) - 1; }
+    static uint32_t generationOf(long id) { return (uint32_t)(id >> IndexBits); }
+
+    struct Registry
+    {
+        Process *first;
+        Process *last;
+        size_t size;
+    };
+
+    void freeSlot(size_t index);
+    void link(Process *process);
+    void unlink(Process *process);
+    void addChild(Process *parent, Process *child);
+    void removeChild(Process *parent, Process *child);
+    void orphan(Process *process);
+
+    std::vector<Slot> slots;
+    std::vector<uint32_t> freeSlots;
+    std::vector<Process *> dense;
+    std::vector<Process *> buried;
+    // indexed by ProcessStmt::index
+    std::vector<Registry> registries;
+    size_t asleep;
+    uint64_t sequence;
+};
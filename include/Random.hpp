@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// xoshiro256** generator. seed() derives the state with splitmix64 from a
+// global seed and a stream number, each process draws from a stream of its
+// own so its numbers do not depend on which thread ticks it or when.
+class Random
+{
+public:
+    Random();
+
+    void seed(uint64_t seed, uint64_t stream);
+
+    uint64_t next()
+    {
+        uint64_t result = rotl(s[1] * 5, 7) * 9;
+        uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+    }
+
+    // min and max included
+    long range(long min, long max);
+    // max excluded
+    double uniform(double min, double max);
+    // count values of uniform(), drawn from Lanes streams split off this one
+    // and stepped side by side so the loop vectorizes
+    void fill(double *out, size_t count, double min, double max);
+
+    static const int Lanes = 4;
+
+private:
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+    uint64_t s[4];
+};
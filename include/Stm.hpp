@@ -29,6 +29,7 @@ enum StmtType
     PROGRAM,
     STMTCALL,
     PROCEDURECALL,
+    FRAME,
     COUNT,
 
 };
@@ -36,7 +37,8 @@ enum StmtType
 struct Stmt
 {
     unsigned long ID{0};
-    
+    // a frame statement is reachable from here, set for process bodies
+    bool yields{false};
 
 
     virtual ~Stmt() {}
@@ -91,6 +93,8 @@ struct Stmt
             return "StmtCall";
         case PROCEDURECALL:
             return "ProcedureCall";
+        case FRAME:
+            return "Frame";
 
         default:
             return "Unknown";
@@ -192,6 +196,16 @@ struct ContinueStmt : public Stmt
     void accept(Visitor *visitor) override;
 };
 
+struct FrameStmt : public Stmt
+{
+    // percent of a frame the wait lasts, 100 when omitted
+    std::shared_ptr<Expr> percent;
+
+    FrameStmt(std::shared_ptr<Expr> percent);
+    StmtType getType() const override { return StmtType::FRAME; }
+    void accept(Visitor *visitor) override;
+};
+
 struct Argument
 {
     std::string name;
@@ -336,6 +350,10 @@ struct ProcessStmt : public Stmt
     std::vector<std::shared_ptr<Argument>> parameter;
     std::shared_ptr<Stmt> body;
     size_t index;
+    // the parameters and the variables of the top scope of the body
+    std::vector<std::string> locals;
+    // index in locals for each field id of the program, -1 where it has none
+    std::vector<int> fields;
 
     ProcessStmt(std::string name, std::vector<std::shared_ptr<Argument>> parameter, std::shared_ptr<Stmt> body);
 
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Hierarchical timer wheel over an integer clock (frames or milliseconds).
+// Level 0 holds the next 64 ticks one per slot, every level above covers 64
+// times the span of the one below and is cascaded down as the clock reaches
+// it. Scheduling is O(1) and advancing costs one slot per elapsed tick plus
+// the timers that come due, no matter how many are pending.
+class TimerWheel
+{
+public:
+    static const int SlotBits = 6;
+    static const int Slots = 1 << SlotBits;
+    static const int Levels = 4;
+
+    TimerWheel();
+
+    // fire id once the clock reaches due, a due in the past fires on the next advance
+    void schedule(long id, int64_t due);
+    // move the clock to now and append the ids that came due
+    void advance(int64_t now, std::vector<long> &expired);
+    void clear();
+
+    int64_t now() const { return current; }
+    size_t size() const { return pending; }
+
+private:
+    struct Timer
+    {
+        long id;
+        int64_t due;
+    };
+
+    void place(const Timer &timer);
+    void cascade(int level);
+
+    std::vector<Timer> wheel[Levels][Slots];
+    // past the span of the top level, re-placed as the clock comes closer
+    std::vector<Timer> overflow;
+    int64_t current;
+    size_t pending;
+};
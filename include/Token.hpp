@@ -77,6 +77,7 @@ enum class TokenType
     IDBYTE,
     IDBOOL,
     IDSTRING,
+    IDVAR,
 
     //DEFENITIONS ID
     IDFUNCTION,
@@ -169,6 +170,7 @@ inline std::string tknString(TokenType type)
         case TokenType::IDBYTE:      return "ID_BYTE";
         case TokenType::IDBOOL:        return "ID_BOOL";
         case TokenType::IDSTRING:      return "ID_STRING";
+        case TokenType::IDVAR:         return "ID_VAR";
         case TokenType::IDFUNCTION:    return "ID_FUNCTION";
         case TokenType::IDPROCEDURE:   return "ID_PROCEDURE";
         case TokenType::IDPROCESS:     return "ID_PROCESS";
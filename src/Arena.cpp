@@ -0,0 +1,45 @@
+#include "pch.h"
+#include "Arena.hpp"
+#include "Memory.hpp"
+
+Arena::Arena(size_t chunkSize) : chunkSize(chunkSize), cursor(nullptr), limit(nullptr), used(0), reserved(0)
+{
+}
+
+Arena::~Arena()
+{
+    release();
+}
+
+void *Arena::allocate(size_t size, size_t align)
+{
+    uintptr_t p = (reinterpret_cast<uintptr_t>(cursor) + (align - 1)) & ~(uintptr_t)(align - 1);
+    if (cursor == nullptr || p + size > reinterpret_cast<uintptr_t>(limit))
+    {
+        size_t bytes = size + align > chunkSize ? size + align : chunkSize;
+        char *chunk = static_cast<char *>(::operator new(bytes));
+        chunks.push_back(chunk);
+        reserved += bytes;
+        Memory::alloc(MEMORY_AST, bytes);
+        cursor = chunk;
+        limit = chunk + bytes;
+        p = (reinterpret_cast<uintptr_t>(cursor) + (align - 1)) & ~(uintptr_t)(align - 1);
+    }
+    cursor = reinterpret_cast<char *>(p + size);
+    used += size;
+    return reinterpret_cast<void *>(p);
+}
+
+void Arena::release()
+{
+    for (char *chunk : chunks)
+    {
+        ::operator delete(chunk);
+    }
+    chunks.clear();
+    Memory::free(MEMORY_AST, reserved);
+    cursor = nullptr;
+    limit = nullptr;
+    used = 0;
+    reserved = 0;
+}
@@ -0,0 +1,78 @@
+#include "pch.h"
+#include "Batch.hpp"
+#include "Interpreter.hpp"
+#include "JobSystem.hpp"
+#include "Input.hpp"
+
+extern void register_core(Interpreter *interpreter);
+extern void register_heap(Interpreter *interpreter);
+
+// game time of a batch frame, the same step the window runs at
+static const double BatchStep = 1.0 / 60.0;
+
+static void runJob(const BatchJob &job, size_t frames, const BatchCollect &collect, BatchResult &result)
+{
+    result.name = job.name;
+    result.compiled = false;
+    result.frames = 0;
+    result.processes = 0;
+    result.ticks = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    // no window, the input natives read an idle keyboard and mouse
+    Input input;
+    input.Disable();
+    Input *previous = Input::Bind(&input);
+
+    Interpreter interpreter;
+    interpreter.init();
+    register_core(&interpreter);
+    register_heap(&interpreter);
+    interpreter.setFixedStep(BatchStep);
+    try
+    {
+        result.compiled = interpreter.compile(job.source);
+        while (result.compiled && result.frames < frames)
+        {
+            input.BeginStep(BatchStep);
+            if (!interpreter.run())
+            {
+                break;
+            }
+            interpreter.getScene().Refresh();
+            result.frames++;
+        }
+    }
+    catch (const std::runtime_error &e)
+    {
+        result.error = e.what();
+    }
+    result.processes = interpreter.Count();
+    result.ticks = interpreter.getSchedulerStats().ticks;
+    result.elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (collect)
+    {
+        collect(interpreter, result);
+    }
+    Input::Bind(previous);
+}
+
+std::vector<BatchResult> RunBatch(const std::vector<BatchJob> &jobs, size_t frames, size_t threads,
+                                  const BatchCollect &collect)
+{
+    std::vector<BatchResult> results(jobs.size());
+    JobSystem pool;
+    pool.start(std::min(threads, jobs.size()));
+    pool.parallelFor(jobs.size(), 1, [&](size_t first, size_t last, size_t worker)
+    {
+        for (size_t i = first; i < last; i++)
+        {
+            // the calling thread may have a scene of its own bound
+            Scene *previous = Scene::Bind(nullptr);
+            runJob(jobs[i], frames, collect, results[i]);
+            Scene::Bind(previous);
+        }
+    });
+    Log(0, "Batch of %zu jobs ran on %zu threads", jobs.size(), pool.workers());
+    return results;
+}
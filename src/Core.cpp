@@ -1,5 +1,6 @@
 #include "pch.h"
 #include "Core.hpp"
+#include "Input.hpp"
 #include "Utils.hpp"
 #include <rlgl.h>
 #include "Interpreter.hpp"
@@ -747,6 +748,30 @@ Instance::Instance()
     matrix = GetWorldTransformation();
 }
 
+void Instance::reset()
+{
+    if (mask)
+        delete mask;
+    mask = nullptr;
+    std::vector<Instance *> entities;
+    entities.swap(m_colide_entities);
+    std::string oldName;
+    oldName.swap(name);
+    *this = Instance();
+    entities.clear();
+    m_colide_entities.swap(entities);
+    oldName.clear();
+    name.swap(oldName);
+}
+
+void Instance::SaveState()
+{
+    prevX = x;
+    prevY = y;
+    prevAngle = angle;
+    stepped = true;
+}
+
 void Instance::Update(double delta)
 {
 
@@ -766,8 +791,6 @@ void Instance::Render()
         return;
     }
 
-    matrix = GetWorldTransformation();
-
     if (graph >= 0)
     {
         Graph gr = Scene::Get().getGraph(graph);
@@ -1018,11 +1041,24 @@ void Instance::setParent(Instance *Parent)
     }
 }
 
+void Instance::detach()
+{
+    if (m_parent == nullptr)
+        return;
+    Vec2 world = m_parent->GetWorldTransformation().TransformCoords(Vec2(x, y));
+    for (Instance *p = m_parent; p != nullptr; p = p->m_parent)
+        angle += p->angle;
+    x = world.x;
+    y = world.y;
+    m_parent = nullptr;
+    SaveState();
+}
+
 Instance *Instance::collide(double x, double y)
 {
     if (!collidable)
         return nullptr;
-    std::vector<Instance *> types = Scene::Get().GetEntities();
+    const InstanceList &types = Scene::Get().GetEntities();
     for (size_t j = 0; j < types.size(); j++)
     {
         Instance *e = types[j];
@@ -1038,7 +1074,7 @@ bool Instance::place_free(double x, double y)
 {
     if (!collidable)
         return false;
-    std::vector<Instance *> types = Scene::Get().GetEntities();
+    const InstanceList &types = Scene::Get().GetEntities();
     for (size_t j = 0; j < types.size(); j++)
     {
         Instance *e = types[j];
@@ -1055,7 +1091,7 @@ bool Instance::place_meeting(double x, double y, std::string &name)
     if (!collidable)
         return false;
 
-    std::vector<Instance *> types = Scene::Get().GetEntities();
+    const InstanceList &types = Scene::Get().GetEntities();
     for (size_t j = 0; j < types.size(); j++)
     {
         Instance *e = types[j];
@@ -1205,6 +1241,8 @@ bool key_exists(const T &container, const Key &key)
     return (container.find(key) != std::end(container));
 }
 
+thread_local Scene *Scene::current = nullptr;
+
 Scene::Scene()
 {
 
@@ -1235,6 +1273,44 @@ Scene::Scene()
     m_entities.reserve(100);
     addLayers(2);
 }
+static size_t texture_bytes(const Texture2D &texture)
+{
+    if (texture.id == 0)
+        return 0;
+    return (size_t)GetPixelDataSize(texture.width, texture.height, texture.format);
+}
+
+static size_t image_bytes(const Image &image)
+{
+    if (image.data == nullptr)
+        return 0;
+    return (size_t)GetPixelDataSize(image.width, image.height, image.format);
+}
+
+// Without a window there is no GPU to upload to, a headless run keeps only
+// the size of the texture (id 0) so clips and points come out the same.
+static Texture2D texture_from_image(const Image &image)
+{
+    if (IsWindowReady())
+        return LoadTextureFromImage(image);
+    Texture2D texture = {0};
+    texture.width = image.width;
+    texture.height = image.height;
+    texture.mipmaps = 1;
+    texture.format = image.format;
+    return texture;
+}
+
+static Texture2D texture_from_file(const std::string &path)
+{
+    if (IsWindowReady())
+        return LoadTexture(path.c_str());
+    Image image = LoadImage(path.c_str());
+    Texture2D texture = texture_from_image(image);
+    UnloadImage(image);
+    return texture;
+}
+
 void Scene::Clear()
 {
 
@@ -1245,20 +1321,27 @@ void Scene::Clear()
         std::string key = it->first;
         Texture2D value = it->second;
         Log(0, "Free Graph (%s)", key.c_str());
-        UnloadTexture(value);
+        Memory::free(MEMORY_TEXTURE, texture_bytes(value));
+        if (value.id != 0)
+            UnloadTexture(value);
     }
+    texture_list.clear();
 
-    for (std::unordered_map<int, Graph>::const_iterator it = graphics.begin(); it != graphics.end(); it++)
+    for (auto it = graphics.begin(); it != graphics.end(); it++)
     {
         int key = it->first;
         if (key >= 0)
         {
             Graph value = it->second;
             if (!value.isClip)
+            {
+                Memory::free(MEMORY_TEXTURE, image_bytes(value.image));
                 UnloadImage(value.image);
+            }
             value.points.clear();
         }
     }
+    graphics.clear();
 
     for (int layer = 0; layer < layersCount(); layer++)
     {
@@ -1275,6 +1358,11 @@ void Scene::Clear()
     }
 
     m_entities.clear();
+    for (Instance *e : m_pool)
+    {
+        delete e;
+    }
+    m_pool.clear();
 }
 
 void Scene::message(int x, int y, Color c, const char *text, ...)
@@ -1300,6 +1388,10 @@ void Scene::message(int x, int y, Color c, const char *text, ...)
 
     DrawText(currentBuffer, x, y, 12, c);
 }
+
+// dead instances kept around for reuse, a spawn burst past this is freed
+static const size_t InstancePoolLimit = 4096;
+
 void Scene::Refresh()
 {
 
@@ -1317,14 +1409,16 @@ void Scene::Refresh()
 
     m_entities.erase(
         std::remove_if(std::begin(m_entities), std::end(m_entities),
-                       [](Instance *entity)
+                       [this](Instance *entity)
                        {
                            if (entity->alive)
                                return false;
 
                            entity->Destroy();
-                           delete entity;
-                           entity = nullptr;
+                           if (m_pool.size() < InstancePoolLimit)
+                               m_pool.push_back(entity);
+                           else
+                               delete entity;
                            return true;
                        }),
         std::end(m_entities));
@@ -1347,10 +1441,75 @@ void Scene::Update(float delta)
     }
 }
 
-void Scene::UpdateAndRefresh()
+void Scene::SaveState()
+{
+    for (auto e : m_entities)
+    {
+        e->SaveState();
+        // get_world_x and the like read the step's transform, not the
+        // blended one of the last frame drawn
+        e->matrix = e->GetWorldTransformation();
+    }
+}
+
+// the shorter way round, an angle wrapping past 360 does not spin back
+static double lerpAngle(double from, double to, double alpha)
+{
+    double delta = std::fmod(to - from, 360.0);
+    if (delta > 180.0)
+        delta -= 360.0;
+    else if (delta < -180.0)
+        delta += 360.0;
+    return from + delta * alpha;
+}
+
+void Scene::BeginInterpolation(double alpha)
+{
+    m_state.clear();
+    m_state.reserve(m_entities.size() * 3);
+    for (auto e : m_entities)
+    {
+        m_state.push_back(e->x);
+        m_state.push_back(e->y);
+        m_state.push_back(e->angle);
+        if (!e->stepped)
+            continue;
+        e->x = e->prevX + (e->x - e->prevX) * alpha;
+        e->y = e->prevY + (e->y - e->prevY) * alpha;
+        e->angle = lerpAngle(e->prevAngle, e->angle, alpha);
+    }
+}
+
+void Scene::EndInterpolation()
+{
+    for (size_t i = 0; i < m_entities.size(); i++)
+    {
+        Instance *e = m_entities[i];
+        e->x = m_state[i * 3];
+        e->y = m_state[i * 3 + 1];
+        e->angle = m_state[i * 3 + 2];
+    }
+}
+
+void Scene::Prepare(double delta, double alpha)
+{
+    Update(delta);
+    if (alpha < 1.0)
+    {
+        BeginInterpolation(alpha);
+    }
+    for (auto e : m_entities)
+    {
+        if (e->alive)
+            e->matrix = e->GetWorldTransformation();
+    }
+}
+
+void Scene::UpdateAndRefresh(double alpha)
 {
 
     Refresh();
+    bool interpolate = alpha < 1.0;
 
     ClearBackground(clearColor);
 
@@ -1361,7 +1520,7 @@ void Scene::UpdateAndRefresh()
 
     BeginMode2D(camera);
 
-    Update(GetFrameTime());
+    Prepare(GetFrameTime(), alpha);
 
     for (int i = 0; i < m_num_layers - 1; i++)
     {
@@ -1378,6 +1537,10 @@ void Scene::UpdateAndRefresh()
         if (e->alive)
             e->Render();
     }
+    if (interpolate)
+    {
+        EndInterpolation();
+    }
 
     DrawRectangle(10, GetScreenHeight() - 40, 250, 200, Fade(SKYBLUE, 0.5f));
     DrawRectangleLines(11, GetScreenHeight() - 40, 248, 200, BLUE);
@@ -1406,7 +1569,17 @@ void Scene::UpdateAndRefresh()
 Instance *Scene::CreateInstance(long ID, const std::string &name, int graph, double x, double y, double angle, int layer)
 
 {
-    Instance *e = new Instance();
+    Instance *e;
+    if (!m_pool.empty())
+    {
+        e = m_pool.back();
+        m_pool.pop_back();
+        e->reset();
+    }
+    else
+    {
+        e = new Instance();
+    }
 
     e->name = name;
     e->id = ID;
@@ -1428,11 +1601,15 @@ Instance *Scene::CreateInstance(long ID, const std::string &name, int graph, dou
 
 Scene::~Scene()
 {
+    if (!m_entities.empty() || !m_pool.empty() || !graphics.empty() || !texture_list.empty())
+    {
+        Clear();
+    }
 }
 
 int Scene::addLayer()
 {
-    std::vector<Instance *> l;
+    InstanceList l;
     l.reserve(100);
     m_layers.emplace(layersCount(), l);
     ++m_num_layers;
@@ -1506,7 +1683,7 @@ int Scene::graph_total_points(int id)
 int Scene::loadGraphFromFile(const std::string &string)
 {
     int index = 100;
-    for (std::unordered_map<int, Graph>::const_iterator it = graphics.begin(); it != graphics.end(); it++)
+    for (auto it = graphics.begin(); it != graphics.end(); it++)
     {
         int key = it->first;
         if (index == key)
@@ -1535,7 +1712,8 @@ bool Scene::addGraphFromFile(const std::string &string, int id)
         }
         else
         {
-            gr.texture = LoadTexture(string.c_str());
+            gr.texture = texture_from_file(string);
+            Memory::alloc(MEMORY_TEXTURE, texture_bytes(gr.texture));
             Log(0, "Load image (%s)  id(%d)  data(%u) size (%d,%d) ", string.c_str(), id, gr.texture.id, gr.texture.width, gr.texture.height);
             texture_list.insert(std::pair<std::string, Texture>(gr.name, gr.texture));
         }
@@ -1603,7 +1781,8 @@ bool Scene::addAtlasGraphFromFile(const std::string &string, int id, int w, int
         else
         {
             gr.image = LoadImage(string.c_str());
-            gr.texture = LoadTextureFromImage(gr.image);
+            gr.texture = texture_from_image(gr.image);
+            Memory::alloc(MEMORY_TEXTURE, image_bytes(gr.image) + texture_bytes(gr.texture));
             Log(0, "Load (%s)  id(%d)  data(%u) size (%d,%d) ", string.c_str(), id, gr.texture.id, gr.image.width, gr.image.height);
             texture_list.insert(std::pair<std::string, Texture>(gr.name, gr.texture));
         }
@@ -1670,7 +1849,12 @@ int Scene::getGraphHeight(int value)
 
 Graph Scene::getGraph(int id)
 {
-    return graphics[id];
+    auto it = graphics.find(id);
+    if (it == graphics.end())
+    {
+        return Graph();
+    }
+    return it->second;
 }
 void Scene::setCameraPosition(float x, float y)
 {
@@ -1729,7 +1913,7 @@ static LiteralPtr native_mouse_down(ExecutionContext *ctx, int argc)
     }
     int button = ctx->getInt(0);
 
-    return ctx->asBool(IsMouseButtonDown(button));
+    return ctx->asBool(Input::Get().MouseDown(button));
 }
 
 static LiteralPtr native_mouse_up(ExecutionContext *ctx, int argc)
@@ -1740,7 +1924,7 @@ static LiteralPtr native_mouse_up(ExecutionContext *ctx, int argc)
     }
     int button = ctx->getInt(0);
 
-    return ctx->asBool(IsMouseButtonUp(button));
+    return ctx->asBool(!Input::Get().MouseDown(button));
 }
 
 static LiteralPtr native_mouse_pressed(ExecutionContext *ctx, int argc)
@@ -1751,7 +1935,7 @@ static LiteralPtr native_mouse_pressed(ExecutionContext *ctx, int argc)
     }
     int button = ctx->getInt(0);
 
-    return ctx->asBool(IsMouseButtonPressed(button));
+    return ctx->asBool(Input::Get().MousePressed(button));
 }
 
 static LiteralPtr native_mouse_released(ExecutionContext *ctx, int argc)
@@ -1762,17 +1946,17 @@ static LiteralPtr native_mouse_released(ExecutionContext *ctx, int argc)
     }
     int button = ctx->getInt(0);
 
-    return ctx->asBool(IsMouseButtonReleased(button));
+    return ctx->asBool(Input::Get().MouseReleased(button));
 }
 
 static LiteralPtr native_mouse_x(ExecutionContext *ctx, int argc)
 {
-    return ctx->asFloat((double)GetMouseX());
+    return ctx->asFloat((double)Input::Get().MouseX());
 }
 
 static LiteralPtr native_mouse_y(ExecutionContext *ctx, int argc)
 {
-    return ctx->asFloat((double)GetMouseY());
+    return ctx->asFloat((double)Input::Get().MouseY());
 }
 
 static LiteralPtr native_keys_down(ExecutionContext *ctx, int argc)
@@ -1783,7 +1967,7 @@ static LiteralPtr native_keys_down(ExecutionContext *ctx, int argc)
         return ctx->asBool(false);
     }
     long key = ctx->getInt(0);
-    return ctx->asBool(IsKeyDown(key));
+    return ctx->asBool(Input::Get().KeyDown(key));
 }
 
 static LiteralPtr native_keys_up(ExecutionContext *ctx, int argc)
@@ -1794,7 +1978,7 @@ static LiteralPtr native_keys_up(ExecutionContext *ctx, int argc)
         return ctx->asBool(false);
     }
     long key = ctx->getInt(0);
-    return ctx->asBool(IsKeyUp(key));
+    return ctx->asBool(!Input::Get().KeyDown(key));
 }
 
 static LiteralPtr native_keys_pressed(ExecutionContext *ctx, int argc)
@@ -1805,7 +1989,7 @@ static LiteralPtr native_keys_pressed(ExecutionContext *ctx, int argc)
         return ctx->asBool(false);
     }
     long key = ctx->getInt(0);
-    return ctx->asBool(IsKeyPressed(key));
+    return ctx->asBool(Input::Get().KeyPressed(key));
 }
 
 static LiteralPtr native_keys_released(ExecutionContext *ctx, int argc)
@@ -1816,32 +2000,32 @@ static LiteralPtr native_keys_released(ExecutionContext *ctx, int argc)
         return ctx->asBool(false);
     }
     long key = ctx->getInt(0);
-    return ctx->asBool(IsKeyReleased(key));
+    return ctx->asBool(Input::Get().KeyReleased(key));
 }
 
 static LiteralPtr native_keys_key(ExecutionContext *ctx, int argc)
 {
-    return ctx->asInt(GetKeyPressed());
+    return ctx->asInt(Input::Get().GetKey());
 }
 
 static LiteralPtr native_keys_char(ExecutionContext *ctx, int argc)
 {
-    return ctx->asInt(GetCharPressed());
+    return ctx->asInt(Input::Get().GetChar());
 }
 
 static const NativeFuncDef native_input_funcs[] =
     {
 
-        {"mouse_down", native_mouse_down},
-        {"mouse_up", native_mouse_up},
-        {"mouse_released", native_mouse_released},
-        {"mouse_pressed", native_mouse_pressed},
-        {"mouse_x", native_mouse_x},
-        {"mouse_y", native_mouse_y},
-        {"key_down", native_keys_down},
-        {"key_up", native_keys_up},
-        {"key_pressed", native_keys_pressed},
-        {"key_released", native_keys_released},
+        {"mouse_down", native_mouse_down, NATIVE_LOCAL},
+        {"mouse_up", native_mouse_up, NATIVE_LOCAL},
+        {"mouse_released", native_mouse_released, NATIVE_LOCAL},
+        {"mouse_pressed", native_mouse_pressed, NATIVE_LOCAL},
+        {"mouse_x", native_mouse_x, NATIVE_LOCAL},
+        {"mouse_y", native_mouse_y, NATIVE_LOCAL},
+        {"key_down", native_keys_down, NATIVE_LOCAL},
+        {"key_up", native_keys_up, NATIVE_LOCAL},
+        {"key_pressed", native_keys_pressed, NATIVE_LOCAL},
+        {"key_released", native_keys_released, NATIVE_LOCAL},
         {"get_key_press", native_keys_key},
         {"get_char_press", native_keys_char},
         {NULL, NULL}};
@@ -1898,7 +2082,8 @@ static LiteralPtr native_delta_time(ExecutionContext *ctx, int argc)
         ctx->Error("Usage: delta_time()");
         return ctx->asFloat(0);
     }
-    return ctx->asFloat(GetFrameTime());
+    double delta = Input::Get().Delta();
+    return ctx->asFloat(delta >= 0 ? delta : Scene::Get().GetDeltaTime());
 }
 
 static LiteralPtr native_time(ExecutionContext *ctx, int argc)
@@ -1908,34 +2093,8 @@ static LiteralPtr native_time(ExecutionContext *ctx, int argc)
         ctx->Error("Usage: Time()");
         return ctx->asFloat(0);
     }
-    return ctx->asFloat(GetTime());
-}
-
-unsigned int g_seed = 0;
-
-void Random_Seed(const int seed)
-{
-    if (!seed)
-    {
-        g_seed = (int)GetTime() * 1000;
-    }
-    else
-    {
-        g_seed = seed;
-    }
-}
-
-long Random_Int(const long min, const long max)
-{
-    g_seed = 214013 * g_seed + 2531011;
-    return min + (g_seed ^ g_seed >> 15) % (max - min + 1);
-}
-
-double Random_Float(const double min, const double max)
-{
-    g_seed = 214013 * g_seed + 2531011;
-    // return min+g_seed*(1.0f/4294967295.0f)*(max-min);
-    return min + (g_seed >> 16) * (1.0f / 65535.0f) * (max - min);
+    double time = Input::Get().Time();
+    return ctx->asFloat(time >= 0 ? time : GetTime());
 }
 
 static LiteralPtr native_range(ExecutionContext *ctx, int argc)
@@ -1947,7 +2106,7 @@ static LiteralPtr native_range(ExecutionContext *ctx, int argc)
     }
     double min = ctx->getFloat(0);
     double max = ctx->getFloat(1);
-    return ctx->asFloat(Random_Float(min, max));
+    return ctx->asFloat(ctx->random().uniform(min, max));
 }
 static LiteralPtr native_random(ExecutionContext *ctx, int argc)
 {
@@ -1958,7 +2117,17 @@ static LiteralPtr native_random(ExecutionContext *ctx, int argc)
     }
     long min = ctx->getInt(0);
     long max = ctx->getInt(1);
-    return ctx->asInt(Random_Int(min, max));
+    return ctx->asInt(ctx->random().range(min, max));
+}
+
+static LiteralPtr native_random_seed(ExecutionContext *ctx, int argc)
+{
+    if (argc != 1)
+    {
+        ctx->Error("Usage: random_seed(seed)");
+        return ctx->asInt(0);
+    }
+    return ctx->asInt((long)ctx->setRandomSeed((uint64_t)ctx->getInt(0)));
 }
 
 static LiteralPtr native_ping_pong(ExecutionContext *ctx, int argc)
@@ -1973,15 +2142,75 @@ static LiteralPtr native_ping_pong(ExecutionContext *ctx, int argc)
     return ctx->asFloat(PingPong(t, l));
 }   
 
+static bool memory_stats(ExecutionContext *ctx, int argc, const char *usage, MemoryStats &stats)
+{
+    if (argc > 1)
+    {
+        ctx->Error(usage);
+        return false;
+    }
+    if (argc == 0)
+    {
+        stats.current = Memory::current();
+        stats.peak = Memory::peak();
+        stats.frameAllocations = 0;
+        stats.frameBytes = 0;
+        for (int i = 0; i < MEMORY_TAGS; i++)
+        {
+            MemoryStats tag = Memory::stats((MemoryTag)i);
+            stats.frameAllocations += tag.frameAllocations;
+            stats.frameBytes += tag.frameBytes;
+        }
+        return true;
+    }
+    std::string name = ctx->getString(0);
+    int tag = Memory::findTag(name);
+    if (tag < 0)
+    {
+        ctx->Error("Unknown memory tag '" + name + "'");
+        return false;
+    }
+    stats = Memory::stats((MemoryTag)tag);
+    return true;
+}
+
+static LiteralPtr native_mem_usage(ExecutionContext *ctx, int argc)
+{
+    MemoryStats stats;
+    if (!memory_stats(ctx, argc, "Usage: mem_usage([tag])", stats))
+        return ctx->asInt(0);
+    return ctx->asInt((long)stats.current);
+}
+
+static LiteralPtr native_mem_peak(ExecutionContext *ctx, int argc)
+{
+    MemoryStats stats;
+    if (!memory_stats(ctx, argc, "Usage: mem_peak([tag])", stats))
+        return ctx->asInt(0);
+    return ctx->asInt((long)stats.peak);
+}
+
+static LiteralPtr native_mem_frame_allocs(ExecutionContext *ctx, int argc)
+{
+    MemoryStats stats;
+    if (!memory_stats(ctx, argc, "Usage: mem_frame_allocs([tag])", stats))
+        return ctx->asInt(0);
+    return ctx->asInt((long)stats.frameAllocations);
+}
+
 static const NativeFuncDef native_core_funcs[] =
     {
         {"Circle", native_circle},
         {"Text", native_text},
-        {"DeltaTime", native_delta_time},
-        {"Time", native_time},
-        {"Range", native_range},
-        {"Random", native_random},
-        {"PingPong", native_ping_pong},
+        {"DeltaTime", native_delta_time, NATIVE_LOCAL},
+        {"Time", native_time, NATIVE_LOCAL},
+        {"Range", native_range, NATIVE_LOCAL},
+        {"Random", native_random, NATIVE_LOCAL},
+        {"random_seed", native_random_seed},
+        {"PingPong", native_ping_pong, NATIVE_LOCAL},
+        {"mem_usage", native_mem_usage, NATIVE_LOCAL},
+        {"mem_peak", native_mem_peak, NATIVE_LOCAL},
+        {"mem_frame_allocs", native_mem_frame_allocs, NATIVE_LOCAL},
 
         {NULL, NULL}};
 
@@ -2064,9 +2293,9 @@ static LiteralPtr native_rotate_towards_mouse(ExecutionContext *ctx, int argc)
         return ctx->asBool(false);
     }
     Process *p = ctx->getCurrentProcess();
-    Vector2 mousePos = GetMousePosition();
+    Vector2 mousePos = {Input::Get().MouseX(), Input::Get().MouseY()};
     double speed = ctx->getFloat(0);
-    double target_angle = atan2(mousePos.y - p->instance->y, mousePos.x - p->instance->x) * 180.0 / M_PI;
+    double target_angle = atan2(mousePos.y - p->getY(), mousePos.x - p->getX()) * 180.0 / M_PI;
     p->rotate_to(-target_angle, speed);
 
     return ctx->asBool(true);
@@ -2083,8 +2312,18 @@ static LiteralPtr native_rotate_towards(ExecutionContext *ctx, int argc)
     }
     Process *p = ctx->getCurrentProcess();
     std::string name = ctx->getString(0);
-    
-    Instance *target = Scene::Get().FindInstanceByName(name);
+
+    Instance *target = nullptr;
+    long type = ctx->typeIndex(name);
+    if (type < 0)
+    {
+        target = Scene::Get().FindInstanceByName(name);
+    }
+    for (Process *other = ctx->firstOfType(type); other && !target; other = other->nextOfType())
+    {
+        if (other->running())
+            target = other->instance;
+    }
     if (target == nullptr)
     {
         ctx->Error("Process not found");
@@ -2093,7 +2332,7 @@ static LiteralPtr native_rotate_towards(ExecutionContext *ctx, int argc)
     double pos_x = target->x;
     double pos_y = target->y;
     double speed = ctx->getFloat(1);
-    double target_angle = -fget_angle(p->instance->x, p->instance->y, pos_x, pos_y);
+    double target_angle = -fget_angle(p->getX(), p->getY(), pos_x, pos_y);
     p->rotate_to(target_angle, speed);
     return ctx->asBool(true);
 }
@@ -2210,8 +2449,20 @@ static LiteralPtr native_place_meeting(ExecutionContext *ctx, int argc)
     double x = ctx->getFloat(0);
     double y = ctx->getFloat(1);
     std::string name = ctx->getString(2);
-    bool result = p->instance->place_meeting(x, y, name);
-    return ctx->asBool(result);
+    long type = ctx->typeIndex(name);
+    if (type < 0)
+        return ctx->asBool(p->instance->place_meeting(x, y, name));
+    if (!p->instance->collidable)
+        return ctx->asBool(false);
+    // only the processes of that type are tested
+    for (Process *other = ctx->firstOfType(type); other; other = other->nextOfType())
+    {
+        if (other == p || !other->running() || !other->instance->collidable)
+            continue;
+        if (p->instance->collideWith(other->instance, x, y))
+            return ctx->asBool(true);
+    }
+    return ctx->asBool(false);
 }
 
 static LiteralPtr native_place_free(ExecutionContext *ctx, int argc)
@@ -2232,24 +2483,261 @@ static LiteralPtr native_place_free(ExecutionContext *ctx, int argc)
 
 
 
+static LiteralPtr native_exists(ExecutionContext *ctx, int argc)
+{
+    if (argc != 1)
+    {
+        ctx->Error("Usage: exists(id)");
+        return ctx->asBool(false);
+    }
+    return ctx->asBool(ctx->findProcess(ctx->getInt(0)) != nullptr);
+}
+
+static LiteralPtr native_kill(ExecutionContext *ctx, int argc)
+{
+    if (argc != 1)
+    {
+        ctx->Error("Usage: kill(id)");
+        return ctx->asBool(false);
+    }
+    Process *p = ctx->findProcess(ctx->getInt(0));
+    if (!p)
+        return ctx->asBool(false);
+    p->kill();
+    return ctx->asBool(true);
+}
+
+static LiteralPtr native_sleep(ExecutionContext *ctx, int argc)
+{
+    if (argc != 1)
+    {
+        ctx->Error("Usage: sleep(ms)");
+        return ctx->asBool(false);
+    }
+    Process *p = ctx->getCurrentProcess();
+    if (!p)
+        return ctx->asBool(false);
+    p->sleep(ctx->getFloat(0));
+    return ctx->asBool(true);
+}
+
+static LiteralPtr native_wait_frames(ExecutionContext *ctx, int argc)
+{
+    if (argc != 1)
+    {
+        ctx->Error("Usage: wait_frames(frames)");
+        return ctx->asBool(false);
+    }
+    Process *p = ctx->getCurrentProcess();
+    if (!p)
+        return ctx->asBool(false);
+    p->wait_frames(ctx->getInt(0));
+    return ctx->asBool(true);
+}
+
+static LiteralPtr native_spawn_many(ExecutionContext *ctx, int argc)
+{
+    if (argc < 2)
+    {
+        ctx->Error("Usage: spawn_many(process, count, ...)");
+        return ctx->asInt(0);
+    }
+    std::string name = ctx->getString(0);
+    long count = ctx->getInt(1);
+    if (count <= 0)
+        return ctx->asInt(0);
+    std::vector<Literal> arguments;
+    arguments.reserve(argc - 2);
+    for (int i = 2; i < argc; i++)
+    {
+        arguments.push_back(*ctx->getLiteral(i));
+    }
+    return ctx->asInt((long)ctx->spawnMany(name, count, arguments));
+}
+
+static LiteralPtr native_get_id(ExecutionContext *ctx, int argc)
+{
+    if (argc != 1)
+    {
+        ctx->Error("Usage: get_id(type)");
+        return ctx->asInt(0);
+    }
+    long type = ctx->typeIndex(ctx->getString(0));
+    if (type < 0)
+    {
+        ctx->Error("get_id: process '" + ctx->getString(0) + "' not defined");
+        return ctx->asInt(0);
+    }
+    return ctx->asInt(ctx->nextOfType(type));
+}
+
+static LiteralPtr native_type_count(ExecutionContext *ctx, int argc)
+{
+    if (argc != 1)
+    {
+        ctx->Error("Usage: type_count(type)");
+        return ctx->asInt(0);
+    }
+    long type = ctx->typeIndex(ctx->getString(0));
+    if (type < 0)
+    {
+        ctx->Error("type_count: process '" + ctx->getString(0) + "' not defined");
+        return ctx->asInt(0);
+    }
+    return ctx->asInt((long)ctx->countOfType(type));
+}
+
+static LiteralPtr native_set_tick_rate(ExecutionContext *ctx, int argc)
+{
+    if (argc != 2)
+    {
+        ctx->Error("Usage: set_tick_rate(type, hz)");
+        return ctx->asBool(false);
+    }
+    if (!ctx->setTickRate(ctx->getString(0), ctx->getFloat(1)))
+    {
+        ctx->Error("set_tick_rate: process '" + ctx->getString(0) + "' not defined");
+        return ctx->asBool(false);
+    }
+    return ctx->asBool(true);
+}
+
+static LiteralPtr native_frame_budget(ExecutionContext *ctx, int argc)
+{
+    if (argc != 1)
+    {
+        ctx->Error("Usage: frame_budget(ms)");
+        return ctx->asFloat(0);
+    }
+    return ctx->asFloat(ctx->setFrameBudget(ctx->getFloat(0)));
+}
+
+static LiteralPtr native_set_deferrable(ExecutionContext *ctx, int argc)
+{
+    if (argc != 2)
+    {
+        ctx->Error("Usage: set_deferrable(type, bool)");
+        return ctx->asBool(false);
+    }
+    if (!ctx->setDeferrable(ctx->getString(0), ctx->getBool(1)))
+    {
+        ctx->Error("set_deferrable: process '" + ctx->getString(0) + "' not defined");
+        return ctx->asBool(false);
+    }
+    return ctx->asBool(true);
+}
+
+static LiteralPtr native_tick_budget(ExecutionContext *ctx, int argc)
+{
+    if (argc != 1 && argc != 2)
+    {
+        ctx->Error("Usage: tick_budget(statements [, b_suspend | b_kill])");
+        return ctx->asInt(0);
+    }
+    bool kill = argc == 2 && ctx->getInt(1) == BUDGET_KILL;
+    return ctx->asInt(ctx->setTickBudget(ctx->getInt(0), kill));
+}
+
+static LiteralPtr native_signal(ExecutionContext *ctx, int argc)
+{
+    if (argc != 2)
+    {
+        ctx->Error("Usage: signal(id | type, s_kill | s_wakeup | s_sleep | s_freeze [_tree])");
+        return ctx->asInt(0);
+    }
+    int code = ctx->getInt(1);
+    int base = code & ~SIGNAL_TREE;
+    if (base < SIGNAL_KILL || base > SIGNAL_FREEZE)
+    {
+        ctx->Error("signal: unknown signal " + std::to_string(code));
+        return ctx->asInt(0);
+    }
+    if (ctx->getLiteral(0)->isString())
+        return ctx->asInt((long)ctx->signalType(ctx->getString(0), code));
+    return ctx->asInt(ctx->signal(ctx->getInt(0), code, Literal()) ? 1 : 0);
+}
+
+static LiteralPtr native_send(ExecutionContext *ctx, int argc)
+{
+    if (argc != 2)
+    {
+        ctx->Error("Usage: send(id, value)");
+        return ctx->asBool(false);
+    }
+    return ctx->asBool(ctx->signal(ctx->getInt(0), SIGNAL_NONE, *ctx->getLiteral(1)));
+}
+
+static LiteralPtr native_receive(ExecutionContext *ctx, int argc)
+{
+    if (argc != 0)
+    {
+        ctx->Error("Usage: receive()");
+        return ctx->asInt(0);
+    }
+    Process *p = ctx->getCurrentProcess();
+    Literal value;
+    if (!p || !p->receive(value))
+        return ctx->asInt(0);
+    return ctx->asLiteral(value);
+}
+
+static LiteralPtr native_messages(ExecutionContext *ctx, int argc)
+{
+    if (argc != 0)
+    {
+        ctx->Error("Usage: messages()");
+        return ctx->asInt(0);
+    }
+    Process *p = ctx->getCurrentProcess();
+    return ctx->asInt(p ? (long)p->messages() : 0);
+}
+
+static LiteralPtr native_sender(ExecutionContext *ctx, int argc)
+{
+    if (argc != 0)
+    {
+        ctx->Error("Usage: sender()");
+        return ctx->asInt(0);
+    }
+    Process *p = ctx->getCurrentProcess();
+    return ctx->asInt(p ? p->sender() : 0);
+}
+
 static const NativeFuncDef native_process_funcs[] =
     {
 
-        {"advance", native_advance},
-        {"xadvance", native_xadvance},
-        {"rotate_towards_mouse", native_rotate_towards_mouse},
+        {"advance", native_advance, NATIVE_LOCAL},
+        {"xadvance", native_xadvance, NATIVE_LOCAL},
+        {"rotate_towards_mouse", native_rotate_towards_mouse, NATIVE_LOCAL},
         {"rotate_towards", native_rotate_towards},
         {"set_parent", native_set_parent},
-        {"center_pivot", native_center_pivot},
-        {"get_local_x", native_get_local_x},
-        {"get_local_y", native_get_local_y},
-        {"get_world_x", native_get_world_x},
-        {"get_world_y", native_get_world_y},
+        {"center_pivot", native_center_pivot, NATIVE_LOCAL},
+        {"get_local_x", native_get_local_x, NATIVE_LOCAL},
+        {"get_local_y", native_get_local_y, NATIVE_LOCAL},
+        {"get_world_x", native_get_world_x, NATIVE_LOCAL},
+        {"get_world_y", native_get_world_y, NATIVE_LOCAL},
+        // reads the parent's angle, which may be ticking on another thread
         {"get_world_angle", native_get_world_angle},
-        {"in_view", native_in_view},
-        {"out_screen", native_out_screen},
+        {"in_view", native_in_view, NATIVE_LOCAL},
+        {"out_screen", native_out_screen, NATIVE_LOCAL},
         {"place_meeting", native_place_meeting},
         {"place_free", native_place_free},
+        {"exists", native_exists},
+        {"kill", native_kill},
+        {"spawn_many", native_spawn_many},
+        {"sleep", native_sleep, NATIVE_LOCAL},
+        {"wait_frames", native_wait_frames, NATIVE_LOCAL},
+        {"get_id", native_get_id},
+        {"type_count", native_type_count},
+        {"set_tick_rate", native_set_tick_rate},
+        {"frame_budget", native_frame_budget},
+        {"tick_budget", native_tick_budget},
+        {"set_deferrable", native_set_deferrable},
+        {"signal", native_signal},
+        {"send", native_send},
+        {"receive", native_receive, NATIVE_LOCAL},
+        {"messages", native_messages, NATIVE_LOCAL},
+        {"sender", native_sender, NATIVE_LOCAL},
 
         {NULL, NULL}};
 
@@ -2295,6 +2783,17 @@ static const NativeFuncDef native_scene_funcs[] =
 
 static void global_scope(ExecutionContext *ctx)
 {
+    ctx->define_int("s_kill", SIGNAL_KILL);
+    ctx->define_int("s_wakeup", SIGNAL_WAKEUP);
+    ctx->define_int("s_sleep", SIGNAL_SLEEP);
+    ctx->define_int("s_freeze", SIGNAL_FREEZE);
+    ctx->define_int("s_kill_tree", SIGNAL_KILL | SIGNAL_TREE);
+    ctx->define_int("s_wakeup_tree", SIGNAL_WAKEUP | SIGNAL_TREE);
+    ctx->define_int("s_sleep_tree", SIGNAL_SLEEP | SIGNAL_TREE);
+    ctx->define_int("s_freeze_tree", SIGNAL_FREEZE | SIGNAL_TREE);
+    ctx->define_int("b_suspend", BUDGET_SUSPEND);
+    ctx->define_int("b_kill", BUDGET_KILL);
+
     ctx->define_int("_left", KEY_LEFT);
     ctx->define_int("_right", KEY_RIGHT);
     ctx->define_int("_up", KEY_UP);
@@ -2345,24 +2844,23 @@ static void global_scope(ExecutionContext *ctx)
 
 void register_core(Interpreter *interpreter)
 {
-    Random_Seed(0);
     for (const NativeFuncDef *def = native_core_funcs; def->name != NULL; def++)
     {
-        interpreter->registerFunction(def->name, def->func);
+        interpreter->registerFunction(def->name, def->func, def->flags);
     }
 
     for (const NativeFuncDef *def = native_input_funcs; def->name != NULL; def++)
     {
-        interpreter->registerFunction(def->name, def->func);
+        interpreter->registerFunction(def->name, def->func, def->flags);
     }
 
     for (const NativeFuncDef *def = native_process_funcs; def->name != NULL; def++)
     {
-        interpreter->registerFunction(def->name, def->func);
+        interpreter->registerFunction(def->name, def->func, def->flags);
     }
     for (const NativeFuncDef *def = native_scene_funcs; def->name != NULL; def++)
     {
-        interpreter->registerFunction(def->name, def->func);
+        interpreter->registerFunction(def->name, def->func, def->flags);
     }
 
     interpreter->registerGlobalScope(global_scope);
@@ -59,6 +59,16 @@ std::shared_ptr<Expr> AssignExpr::accept(Visitor *visitor)
     return visitor->visitAssignExpr(this);
 }
 
+std::shared_ptr<Expr> FieldExpr::accept(Visitor *visitor)
+{
+    return visitor->visitFieldExpr(this);
+}
+
+std::shared_ptr<Expr> FieldAssignExpr::accept(Visitor *visitor)
+{
+    return visitor->visitFieldAssignExpr(this);
+}
+
 
 
 std::shared_ptr<Expr> CallerExpr::accept(Visitor *visitor)
@@ -0,0 +1,645 @@
+#include "pch.h"
+#include "Heap.hpp"
+#include "Interpreter.hpp"
+#include "Utils.hpp"
+#include <algorithm>
+
+static const size_t TraceSlice = 256;
+static const size_t ReleaseSlice = 1024;
+static const size_t MinThreshold = 256;
+static const size_t PauseHistory = 512;
+
+static double now_ms()
+{
+    auto now = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(now.time_since_epoch()).count();
+}
+
+//*****************************************************************************************
+
+size_t ListObject::trace(Heap &heap, size_t from, size_t budget)
+{
+    size_t end = std::min(items.size(), from + budget);
+    for (size_t i = from; i < end; i++)
+    {
+        heap.shade(items[i]);
+    }
+    return end;
+}
+
+size_t ListObject::shrink(size_t budget)
+{
+    size_t n = std::min(items.size(), budget);
+    items.resize(items.size() - n);
+    return items.size();
+}
+
+std::string ListObject::toString() const
+{
+    return "list(" + std::to_string(items.size()) + ")";
+}
+
+Literal *MapObject::get(const std::string &key)
+{
+    auto it = index.find(key);
+    if (it == index.end())
+        return nullptr;
+    return &values[it->second];
+}
+
+void MapObject::set(const std::string &key, const Literal &value)
+{
+    auto it = index.find(key);
+    if (it != index.end())
+    {
+        values[it->second] = value;
+        return;
+    }
+    index[key] = values.size();
+    keys.push_back(key);
+    values.push_back(value);
+}
+
+bool MapObject::remove(const std::string &key)
+{
+    auto it = index.find(key);
+    if (it == index.end())
+        return false;
+    size_t slot = it->second;
+    size_t last = values.size() - 1;
+    if (slot != last)
+    {
+        keys[slot] = std::move(keys[last]);
+        values[slot] = std::move(values[last]);
+        index[keys[slot]] = slot;
+    }
+    index.erase(it);
+    keys.pop_back();
+    values.pop_back();
+    return true;
+}
+
+size_t MapObject::trace(Heap &heap, size_t from, size_t budget)
+{
+    size_t end = std::min(values.size(), from + budget);
+    for (size_t i = from; i < end; i++)
+    {
+        heap.shade(values[i]);
+    }
+    return end;
+}
+
+size_t MapObject::shrink(size_t budget)
+{
+    size_t n = std::min(values.size(), budget);
+    for (size_t i = 0; i < n; i++)
+    {
+        index.erase(keys.back());
+        keys.pop_back();
+        values.pop_back();
+    }
+    return values.size();
+}
+
+std::string MapObject::toString() const
+{
+    return "map(" + std::to_string(values.size()) + ")";
+}
+
+//*****************************************************************************************
+
+Heap::Heap()
+{
+    phase = IDLE;
+    sweepCursor = 0;
+    threshold = MinThreshold;
+    allocatedSinceCycle = 0;
+    fullRequested = false;
+    budget = 0.5;
+    unbounded = false;
+    stepStart = 0.0;
+    rootEpoch = 0;
+    stats = HeapStats{};
+    pauses.resize(PauseHistory, 0.0);
+    pauseIndex = 0;
+}
+
+Heap::~Heap()
+{
+    clear();
+}
+
+void Heap::track(HeapObject *object)
+{
+    // objects born during a cycle are black, they survive it
+    object->marked = (phase != IDLE);
+    objects.push_back(object);
+    allocatedSinceCycle++;
+    stats.allocated++;
+    stats.objects = objects.size();
+}
+
+ListObject *Heap::newList()
+{
+    ListObject *list = new ListObject();
+    track(list);
+    return list;
+}
+
+MapObject *Heap::newMap()
+{
+    MapObject *map = new MapObject();
+    track(map);
+    return map;
+}
+
+void Heap::shade(HeapObject *object)
+{
+    if (object == nullptr || object->marked)
+        return;
+    object->marked = true;
+    gray.push_back({object, 0});
+}
+
+void Heap::shade(const Literal &value)
+{
+    if (value.isObject())
+    {
+        shade(value.getObject());
+    }
+}
+
+void Heap::barrier(const Literal &value)
+{
+    if (phase == MARK)
+    {
+        shade(value);
+    }
+}
+
+void Heap::scanRoots()
+{
+    rootEpoch++;
+    if (markRoots)
+    {
+        markRoots(*this);
+    }
+}
+
+bool Heap::expired() const
+{
+    if (unbounded)
+        return false;
+    return now_ms() - stepStart >= budget;
+}
+
+bool Heap::mark(size_t &work)
+{
+    while (!gray.empty())
+    {
+        if (expired())
+            return false;
+        GrayEntry entry = gray.back();
+        gray.pop_back();
+        size_t next = entry.object->trace(*this, entry.cursor, TraceSlice);
+        work += next - entry.cursor + 1;
+        if (next < entry.object->count())
+        {
+            gray.push_back({entry.object, next});
+        }
+    }
+    return true;
+}
+
+bool Heap::sweep(size_t &work)
+{
+    while (sweepCursor < objects.size())
+    {
+        if (expired())
+            return false;
+        HeapObject *object = objects[sweepCursor];
+        if (object->marked)
+        {
+            object->marked = false;
+            sweepCursor++;
+        }
+        else
+        {
+            objects[sweepCursor] = objects.back();
+            objects.pop_back();
+            dying.push_back(object);
+        }
+        work++;
+    }
+    stats.objects = objects.size();
+    return true;
+}
+
+bool Heap::release(size_t &work)
+{
+    while (!dying.empty())
+    {
+        if (expired())
+            return false;
+        HeapObject *object = dying.back();
+        work += ReleaseSlice;
+        if (object->shrink(ReleaseSlice) == 0)
+        {
+            delete object;
+            dying.pop_back();
+            stats.freed++;
+        }
+    }
+    return true;
+}
+
+void Heap::step()
+{
+    bool start = allocatedSinceCycle >= threshold || fullRequested;
+    if (phase == IDLE && dying.empty() && !start)
+        return;
+
+    stepStart = now_ms();
+    unbounded = fullRequested;
+    fullRequested = false;
+    size_t work = 0;
+
+    if (phase == IDLE && start)
+    {
+        phase = MARK;
+        stats.cycles++;
+        allocatedSinceCycle = 0;
+        scanRoots();
+    }
+
+    while (true)
+    {
+        if (!dying.empty())
+        {
+            if (!release(work))
+                break;
+            continue;
+        }
+        if (phase == MARK)
+        {
+            if (!mark(work))
+                break;
+            // roots are not write-barriered, rescan them before sweeping
+            scanRoots();
+            if (gray.empty())
+            {
+                phase = SWEEP;
+                sweepCursor = 0;
+            }
+            continue;
+        }
+        if (phase == SWEEP)
+        {
+            if (!sweep(work))
+                break;
+            phase = IDLE;
+            threshold = std::max(MinThreshold, objects.size());
+            continue;
+        }
+        break;
+    }
+
+    unbounded = false;
+    record(now_ms() - stepStart);
+}
+
+void Heap::record(double ms)
+{
+    stats.steps++;
+    stats.lastPause = ms;
+    stats.totalPause += ms;
+    if (ms > stats.maxPause)
+        stats.maxPause = ms;
+    pauses[pauseIndex] = ms;
+    pauseIndex = (pauseIndex + 1) % pauses.size();
+}
+
+double Heap::pausePercentile(double p) const
+{
+    size_t count = std::min(stats.steps, pauses.size());
+    if (count == 0)
+        return 0.0;
+    std::vector<double> sorted(pauses.begin(), pauses.begin() + count);
+    std::sort(sorted.begin(), sorted.end());
+    size_t at = (size_t)(p / 100.0 * (double)(count - 1));
+    return sorted[at];
+}
+
+void Heap::clear()
+{
+    for (HeapObject *object : objects)
+    {
+        delete object;
+    }
+    for (HeapObject *object : dying)
+    {
+        delete object;
+    }
+    objects.clear();
+    dying.clear();
+    gray.clear();
+    phase = IDLE;
+    sweepCursor = 0;
+    allocatedSinceCycle = 0;
+    threshold = MinThreshold;
+    stats.objects = 0;
+}
+
+void Heap::printStats() const
+{
+    double avg = stats.steps > 0 ? stats.totalPause / (double)stats.steps : 0.0;
+    Log(0, "GC objects: %zu allocated: %zu freed: %zu cycles: %zu", stats.objects, stats.allocated, stats.freed, stats.cycles);
+    Log(0, "GC steps: %zu pause avg: %.3f ms p99: %.3f ms max: %.3f ms (budget %.2f ms)",
+        stats.steps, avg, pausePercentile(99.0), stats.maxPause, budget);
+}
+
+//*****************************************************************************************
+
+static ListObject *get_list(ExecutionContext *ctx, size_t index)
+{
+    HeapObject *object = ctx->getObject(index);
+    if (object == nullptr || object->getType() != HEAP_LIST)
+    {
+        ctx->Error("Argument " + std::to_string(index) + " is not a list");
+        return nullptr;
+    }
+    return static_cast<ListObject *>(object);
+}
+
+static MapObject *get_map(ExecutionContext *ctx, size_t index)
+{
+    HeapObject *object = ctx->getObject(index);
+    if (object == nullptr || object->getType() != HEAP_MAP)
+    {
+        ctx->Error("Argument " + std::to_string(index) + " is not a map");
+        return nullptr;
+    }
+    return static_cast<MapObject *>(object);
+}
+
+static LiteralPtr native_list(ExecutionContext *ctx, int argc)
+{
+    ListObject *list = ctx->getHeap()->newList();
+    for (int i = 0; i < argc; i++)
+    {
+        const Literal &value = *ctx->getLiteral(i);
+        list->items.push_back(value);
+        ctx->getHeap()->barrier(value);
+    }
+    return ctx->asObject(list);
+}
+
+// count floats in [min, max) from the caller's random stream, generated in bulk
+static LiteralPtr native_random_list(ExecutionContext *ctx, int argc)
+{
+    if (argc != 3)
+    {
+        ctx->Error("Usage: random_list(count, min, max)");
+        return ctx->asInt(0);
+    }
+    std::vector<double> values((size_t)std::max(0L, ctx->getInt(0)));
+    ctx->random().fill(values.data(), values.size(), ctx->getFloat(1), ctx->getFloat(2));
+    ListObject *list = ctx->getHeap()->newList();
+    list->items.reserve(values.size());
+    for (double value : values)
+    {
+        list->items.push_back(Literal(value));
+    }
+    return ctx->asObject(list);
+}
+
+static LiteralPtr native_list_push(ExecutionContext *ctx, int argc)
+{
+    if (argc != 2)
+    {
+        ctx->Error("Usage: list_push(list, value)");
+        return ctx->asInt(0);
+    }
+    ListObject *list = get_list(ctx, 0);
+    const Literal &value = *ctx->getLiteral(1);
+    list->items.push_back(value);
+    ctx->getHeap()->barrier(value);
+    return ctx->asInt((long)list->items.size());
+}
+
+static LiteralPtr native_list_pop(ExecutionContext *ctx, int argc)
+{
+    if (argc != 1)
+    {
+        ctx->Error("Usage: list_pop(list)");
+        return ctx->asInt(0);
+    }
+    ListObject *list = get_list(ctx, 0);
+    if (list->items.empty())
+    {
+        ctx->Error("list_pop: list is empty");
+        return ctx->asInt(0);
+    }
+    Literal value = list->items.back();
+    list->items.pop_back();
+    return ctx->asLiteral(value);
+}
+
+static LiteralPtr native_list_get(ExecutionContext *ctx, int argc)
+{
+    if (argc != 2)
+    {
+        ctx->Error("Usage: list_get(list, index)");
+        return ctx->asInt(0);
+    }
+    ListObject *list = get_list(ctx, 0);
+    long index = ctx->getInt(1);
+    if (index < 0 || index >= (long)list->items.size())
+    {
+        ctx->Error("list_get: index " + std::to_string(index) + " out of range");
+        return ctx->asInt(0);
+    }
+    return ctx->asLiteral(list->items[index]);
+}
+
+static LiteralPtr native_list_set(ExecutionContext *ctx, int argc)
+{
+    if (argc != 3)
+    {
+        ctx->Error("Usage: list_set(list, index, value)");
+        return ctx->asBool(false);
+    }
+    ListObject *list = get_list(ctx, 0);
+    long index = ctx->getInt(1);
+    if (index < 0 || index >= (long)list->items.size())
+    {
+        ctx->Error("list_set: index " + std::to_string(index) + " out of range");
+        return ctx->asBool(false);
+    }
+    const Literal &value = *ctx->getLiteral(2);
+    list->items[index] = value;
+    ctx->getHeap()->barrier(value);
+    return ctx->asBool(true);
+}
+
+static LiteralPtr native_list_size(ExecutionContext *ctx, int argc)
+{
+    if (argc != 1)
+    {
+        ctx->Error("Usage: list_size(list)");
+        return ctx->asInt(0);
+    }
+    ListObject *list = get_list(ctx, 0);
+    return ctx->asInt((long)list->items.size());
+}
+
+static LiteralPtr native_list_clear(ExecutionContext *ctx, int argc)
+{
+    if (argc != 1)
+    {
+        ctx->Error("Usage: list_clear(list)");
+        return ctx->asBool(false);
+    }
+    ListObject *list = get_list(ctx, 0);
+    list->items.clear();
+    return ctx->asBool(true);
+}
+
+static LiteralPtr native_map(ExecutionContext *ctx, int argc)
+{
+    if (argc != 0)
+    {
+        ctx->Error("Usage: map()");
+        return ctx->asInt(0);
+    }
+    return ctx->asObject(ctx->getHeap()->newMap());
+}
+
+static LiteralPtr native_map_set(ExecutionContext *ctx, int argc)
+{
+    if (argc != 3)
+    {
+        ctx->Error("Usage: map_set(map, key, value)");
+        return ctx->asBool(false);
+    }
+    MapObject *map = get_map(ctx, 0);
+    const Literal &value = *ctx->getLiteral(2);
+    map->set(ctx->getString(1), value);
+    ctx->getHeap()->barrier(value);
+    return ctx->asBool(true);
+}
+
+static LiteralPtr native_map_get(ExecutionContext *ctx, int argc)
+{
+    if (argc != 2)
+    {
+        ctx->Error("Usage: map_get(map, key)");
+        return ctx->asInt(0);
+    }
+    MapObject *map = get_map(ctx, 0);
+    std::string key = ctx->getString(1);
+    Literal *value = map->get(key);
+    if (value == nullptr)
+    {
+        ctx->Error("map_get: key '" + key + "' not found");
+        return ctx->asInt(0);
+    }
+    return ctx->asLiteral(*value);
+}
+
+static LiteralPtr native_map_has(ExecutionContext *ctx, int argc)
+{
+    if (argc != 2)
+    {
+        ctx->Error("Usage: map_has(map, key)");
+        return ctx->asBool(false);
+    }
+    MapObject *map = get_map(ctx, 0);
+    return ctx->asBool(map->contains(ctx->getString(1)));
+}
+
+static LiteralPtr native_map_remove(ExecutionContext *ctx, int argc)
+{
+    if (argc != 2)
+    {
+        ctx->Error("Usage: map_remove(map, key)");
+        return ctx->asBool(false);
+    }
+    MapObject *map = get_map(ctx, 0);
+    return ctx->asBool(map->remove(ctx->getString(1)));
+}
+
+static LiteralPtr native_map_size(ExecutionContext *ctx, int argc)
+{
+    if (argc != 1)
+    {
+        ctx->Error("Usage: map_size(map)");
+        return ctx->asInt(0);
+    }
+    MapObject *map = get_map(ctx, 0);
+    return ctx->asInt((long)map->count());
+}
+
+static LiteralPtr native_gc_collect(ExecutionContext *ctx, int argc)
+{
+    if (argc != 0)
+    {
+        ctx->Error("Usage: gc_collect()");
+        return ctx->asBool(false);
+    }
+    // runs at the end of the frame, when no temporaries are alive
+    ctx->getHeap()->requestFull();
+    return ctx->asBool(true);
+}
+
+static LiteralPtr native_gc_budget(ExecutionContext *ctx, int argc)
+{
+    if (argc != 1)
+    {
+        ctx->Error("Usage: gc_budget(ms)");
+        return ctx->asFloat(0);
+    }
+    double previous = ctx->getHeap()->getBudget();
+    ctx->getHeap()->setBudget(ctx->getFloat(0));
+    return ctx->asFloat(previous);
+}
+
+static LiteralPtr native_gc_objects(ExecutionContext *ctx, int argc)
+{
+    if (argc != 0)
+    {
+        ctx->Error("Usage: gc_objects()");
+        return ctx->asInt(0);
+    }
+    return ctx->asInt((long)ctx->getHeap()->getStats().objects);
+}
+
+static const NativeFuncDef native_heap_funcs[] =
+    {
+        {"list", native_list},
+        {"list_push", native_list_push},
+        {"list_pop", native_list_pop},
+        {"list_get", native_list_get},
+        {"list_set", native_list_set},
+        {"list_size", native_list_size},
+        {"list_clear", native_list_clear},
+        {"random_list", native_random_list},
+        {"map", native_map},
+        {"map_set", native_map_set},
+        {"map_get", native_map_get},
+        {"map_has", native_map_has},
+        {"map_remove", native_map_remove},
+        {"map_size", native_map_size},
+        {"gc_collect", native_gc_collect},
+        {"gc_budget", native_gc_budget},
+        {"gc_objects", native_gc_objects},
+
+        {NULL, NULL}};
+
+void register_heap(Interpreter *interpreter)
+{
+    for (const NativeFuncDef *def = native_heap_funcs; def->name != NULL; def++)
+    {
+        interpreter->registerFunction(def->name, def->func, def->flags);
+    }
+}
@@ -0,0 +1,447 @@
+#include "pch.h"
+#include "Input.hpp"
+#include "Utils.hpp"
+#include <cstring>
+#include <raylib.h>
+
+static const char TapeMagic[4] = {'B', 'U', 'I', 'N'};
+static const int TapeVersion = 1;
+
+// what a step record holds besides its flags byte
+enum TapeFlags
+{
+    TAPE_DELTA = 1,
+    TAPE_MOUSE = 2,
+    TAPE_BUTTONS = 4,
+    TAPE_KEYS_DOWN = 8,
+    TAPE_KEY_EDGES = 16,
+    TAPE_QUEUES = 32
+};
+
+typedef std::bitset<InputFrame::KeyCount> KeySet;
+
+// little endian whatever the host
+static void put(std::ofstream &out, uint64_t value, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+    {
+        out.put((char)((value >> (i * 8)) & 0xff));
+    }
+}
+
+static uint64_t get(std::ifstream &in, int bytes)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++)
+    {
+        value |= (uint64_t)(uint8_t)in.get() << (i * 8);
+    }
+    return value;
+}
+
+static void putFloat(std::ofstream &out, float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    put(out, bits, 4);
+}
+
+static float getFloat(std::ifstream &in)
+{
+    uint32_t bits = (uint32_t)get(in, 4);
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static void putDouble(std::ofstream &out, double value)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    put(out, bits, 8);
+}
+
+static double getDouble(std::ifstream &in)
+{
+    uint64_t bits = get(in, 8);
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static void putKeys(std::ofstream &out, const KeySet &keys)
+{
+    put(out, keys.count(), 2);
+    for (int key = 0; key < InputFrame::KeyCount; key++)
+    {
+        if (keys[key])
+            put(out, key, 2);
+    }
+}
+
+// toggles the keys read, so a set of changes applies onto the previous state
+static void getKeys(std::ifstream &in, KeySet &keys)
+{
+    size_t count = get(in, 2);
+    for (size_t i = 0; i < count; i++)
+    {
+        keys.flip(get(in, 2) % InputFrame::KeyCount);
+    }
+}
+
+static void putQueue(std::ofstream &out, const std::vector<int> &queue)
+{
+    put(out, queue.size(), 2);
+    for (int value : queue)
+    {
+        put(out, (uint32_t)value, 4);
+    }
+}
+
+static void getQueue(std::ifstream &in, std::vector<int> &queue)
+{
+    size_t count = get(in, 2);
+    for (size_t i = 0; i < count; i++)
+    {
+        queue.push_back((int)(uint32_t)get(in, 4));
+    }
+}
+
+InputFrame::InputFrame()
+{
+    buttonsDown = 0;
+    buttonsPressed = 0;
+    buttonsReleased = 0;
+    mouseX = 0;
+    mouseY = 0;
+    delta = 0;
+    time = 0;
+}
+
+void InputFrame::clearEdges()
+{
+    keysPressed.reset();
+    keysReleased.reset();
+    buttonsPressed = 0;
+    buttonsReleased = 0;
+    keys.clear();
+    chars.clear();
+}
+
+thread_local Input *Input::current = nullptr;
+
+Input::Input() : mode(INPUT_LIVE), stepping(false), finished(false), steps(0), nextKey(0), nextChar(0)
+{
+}
+
+bool Input::Record(const std::string &path)
+{
+    Stop();
+    out.open(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        Log(2, "Input: can not write %s", path.c_str());
+        return false;
+    }
+    out.write(TapeMagic, sizeof(TapeMagic));
+    out.put((char)TapeVersion);
+    frame = InputFrame();
+    previous = InputFrame();
+    mode = INPUT_RECORD;
+    steps = 0;
+    Log(0, "Input: recording to %s", path.c_str());
+    return true;
+}
+
+bool Input::Replay(const std::string &path)
+{
+    Stop();
+    in.open(path, std::ios::binary);
+    char magic[sizeof(TapeMagic)];
+    if (!in || !in.read(magic, sizeof(magic)) || std::memcmp(magic, TapeMagic, sizeof(magic)) != 0 ||
+        in.get() != TapeVersion)
+    {
+        Log(2, "Input: %s is not an input tape", path.c_str());
+        in.close();
+        return false;
+    }
+    frame = InputFrame();
+    mode = INPUT_REPLAY;
+    finished = false;
+    steps = 0;
+    Log(0, "Input: replaying %s", path.c_str());
+    return true;
+}
+
+void Input::Disable()
+{
+    Stop();
+    frame = InputFrame();
+    pending = InputFrame();
+    mode = INPUT_NONE;
+    steps = 0;
+}
+
+void Input::Stop()
+{
+    if (out.is_open())
+    {
+        out.close();
+        Log(0, "Input: recorded %zu steps", steps);
+    }
+    if (in.is_open())
+    {
+        in.close();
+    }
+    mode = INPUT_LIVE;
+}
+
+void Input::Poll()
+{
+    if (mode == INPUT_REPLAY || mode == INPUT_NONE)
+    {
+        return;
+    }
+    for (int key = 0; key < InputFrame::KeyCount; key++)
+    {
+        if (IsKeyPressed(key))
+            pending.keysPressed.set(key);
+        if (IsKeyReleased(key))
+            pending.keysReleased.set(key);
+    }
+    for (int button = 0; button < ButtonCount; button++)
+    {
+        if (IsMouseButtonPressed(button))
+            pending.buttonsPressed |= 1 << button;
+        if (IsMouseButtonReleased(button))
+            pending.buttonsReleased |= 1 << button;
+    }
+    for (int key = GetKeyPressed(); key != 0; key = GetKeyPressed())
+        pending.keys.push_back(key);
+    for (int c = GetCharPressed(); c != 0; c = GetCharPressed())
+        pending.chars.push_back(c);
+}
+
+void Input::BeginStep(double delta)
+{
+    stepping = true;
+    nextKey = 0;
+    nextChar = 0;
+    if (mode == INPUT_REPLAY)
+    {
+        if (!finished && !read())
+        {
+            finished = true;
+            Log(0, "Input: replay finished after %zu steps", steps);
+        }
+        if (finished)
+        {
+            // everything let go once the tape ran out
+            frame.clearEdges();
+            frame.keysDown.reset();
+            frame.buttonsDown = 0;
+            frame.delta = delta;
+            frame.time += delta;
+            return;
+        }
+    }
+    else if (mode == INPUT_NONE)
+    {
+        frame.delta = delta;
+        frame.time += delta;
+    }
+    else
+    {
+        capture(delta);
+        if (mode == INPUT_RECORD)
+        {
+            write();
+        }
+    }
+    steps++;
+}
+
+void Input::capture(double delta)
+{
+    frame.keysPressed = pending.keysPressed;
+    frame.keysReleased = pending.keysReleased;
+    frame.buttonsPressed = pending.buttonsPressed;
+    frame.buttonsReleased = pending.buttonsReleased;
+    frame.keys.swap(pending.keys);
+    frame.chars.swap(pending.chars);
+    pending.clearEdges();
+
+    for (int key = 0; key < InputFrame::KeyCount; key++)
+    {
+        frame.keysDown[key] = IsKeyDown(key);
+    }
+    frame.buttonsDown = 0;
+    for (int button = 0; button < ButtonCount; button++)
+    {
+        if (IsMouseButtonDown(button))
+            frame.buttonsDown |= 1 << button;
+    }
+    frame.mouseX = (float)GetMouseX();
+    frame.mouseY = (float)GetMouseY();
+    frame.delta = delta;
+    frame.time += delta;
+}
+
+void Input::write()
+{
+    KeySet toggled = frame.keysDown ^ previous.keysDown;
+    int flags = 0;
+    if (frame.delta != previous.delta)
+        flags |= TAPE_DELTA;
+    if (frame.mouseX != previous.mouseX || frame.mouseY != previous.mouseY)
+        flags |= TAPE_MOUSE;
+    if (frame.buttonsDown != previous.buttonsDown || frame.buttonsPressed || frame.buttonsReleased)
+        flags |= TAPE_BUTTONS;
+    if (toggled.any())
+        flags |= TAPE_KEYS_DOWN;
+    if (frame.keysPressed.any() || frame.keysReleased.any())
+        flags |= TAPE_KEY_EDGES;
+    if (!frame.keys.empty() || !frame.chars.empty())
+        flags |= TAPE_QUEUES;
+
+    out.put((char)flags);
+    if (flags & TAPE_DELTA)
+        putDouble(out, frame.delta);
+    if (flags & TAPE_MOUSE)
+    {
+        putFloat(out, frame.mouseX);
+        putFloat(out, frame.mouseY);
+    }
+    if (flags & TAPE_BUTTONS)
+    {
+        out.put((char)frame.buttonsDown);
+        out.put((char)frame.buttonsPressed);
+        out.put((char)frame.buttonsReleased);
+    }
+    if (flags & TAPE_KEYS_DOWN)
+        putKeys(out, toggled);
+    if (flags & TAPE_KEY_EDGES)
+    {
+        putKeys(out, frame.keysPressed);
+        putKeys(out, frame.keysReleased);
+    }
+    if (flags & TAPE_QUEUES)
+    {
+        putQueue(out, frame.keys);
+        putQueue(out, frame.chars);
+    }
+    previous = frame;
+}
+
+bool Input::read()
+{
+    int flags = in.get();
+    if (flags == std::char_traits<char>::eof())
+    {
+        return false;
+    }
+    frame.clearEdges();
+    if (flags & TAPE_DELTA)
+        frame.delta = getDouble(in);
+    frame.time += frame.delta;
+    if (flags & TAPE_MOUSE)
+    {
+        frame.mouseX = getFloat(in);
+        frame.mouseY = getFloat(in);
+    }
+    if (flags & TAPE_BUTTONS)
+    {
+        frame.buttonsDown = (uint8_t)in.get();
+        frame.buttonsPressed = (uint8_t)in.get();
+        frame.buttonsReleased = (uint8_t)in.get();
+    }
+    if (flags & TAPE_KEYS_DOWN)
+        getKeys(in, frame.keysDown);
+    if (flags & TAPE_KEY_EDGES)
+    {
+        getKeys(in, frame.keysPressed);
+        getKeys(in, frame.keysReleased);
+    }
+    if (flags & TAPE_QUEUES)
+    {
+        getQueue(in, frame.keys);
+        getQueue(in, frame.chars);
+    }
+    return (bool)in;
+}
+
+bool Input::KeyDown(int key) const
+{
+    if (!stepping)
+        return IsKeyDown(key);
+    return key >= 0 && key < InputFrame::KeyCount && frame.keysDown[key];
+}
+
+bool Input::KeyPressed(int key) const
+{
+    if (!stepping)
+        return IsKeyPressed(key);
+    return key >= 0 && key < InputFrame::KeyCount && frame.keysPressed[key];
+}
+
+bool Input::KeyReleased(int key) const
+{
+    if (!stepping)
+        return IsKeyReleased(key);
+    return key >= 0 && key < InputFrame::KeyCount && frame.keysReleased[key];
+}
+
+bool Input::MouseDown(int button) const
+{
+    if (!stepping)
+        return IsMouseButtonDown(button);
+    return button >= 0 && button < ButtonCount && (frame.buttonsDown >> button) & 1;
+}
+
+bool Input::MousePressed(int button) const
+{
+    if (!stepping)
+        return IsMouseButtonPressed(button);
+    return button >= 0 && button < ButtonCount && (frame.buttonsPressed >> button) & 1;
+}
+
+bool Input::MouseReleased(int button) const
+{
+    if (!stepping)
+        return IsMouseButtonReleased(button);
+    return button >= 0 && button < ButtonCount && (frame.buttonsReleased >> button) & 1;
+}
+
+float Input::MouseX() const
+{
+    return stepping ? frame.mouseX : (float)GetMouseX();
+}
+
+float Input::MouseY() const
+{
+    return stepping ? frame.mouseY : (float)GetMouseY();
+}
+
+int Input::GetKey()
+{
+    if (!stepping)
+        return GetKeyPressed();
+    return nextKey < frame.keys.size() ? frame.keys[nextKey++] : 0;
+}
+
+int Input::GetChar()
+{
+    if (!stepping)
+        return GetCharPressed();
+    return nextChar < frame.chars.size() ? frame.chars[nextChar++] : 0;
+}
+
+double Input::Delta() const
+{
+    return stepping ? frame.delta : -1;
+}
+
+double Input::Time() const
+{
+    return stepping && mode != INPUT_LIVE ? frame.time : -1;
+}
@@ -3,33 +3,70 @@
 #include "Literal.hpp"
 #include "Utils.hpp"
 
-long processID = 0;
 
 static uintptr_t getAddress(const void *ptr)
 {
     return reinterpret_cast<uintptr_t>(ptr);
 }
 
+// frames kept for the frame time percentiles
+static const size_t FrameHistory = 512;
+
 Interpreter::Interpreter()
 {
     lexer.initialize(); 
+    setRandomSeed(0);
+    fixedStep = 0;
 }
 
 Interpreter::~Interpreter()
 {
     cleanup();
+    if (scene && Scene::IsBound(scene.get()))
+    {
+        Scene::Bind(nullptr);
+    }
 }
 
 void Interpreter::init()
 {
 
     Info("Create Interpreter");
-    currentDepth = 0;
-    addressLoop = 0x0;
+    // scene, literal factory, process ids and random state are all this
+    // interpreter's, several can run at once on different threads
+    scene = std::make_unique<Scene>();
+    Scene::Bind(scene.get());
+    mainState.currentDepth = 0;
+    mainState.addressLoop = 0x0;
     mainEnvironment = std::make_shared<Environment>(0, nullptr);
-    
 
-    environmentStack.push(mainEnvironment);
+    std::vector<Literal> builtins;
+    for (int i = 0; processLocals[i].name != NULL; i++)
+    {
+        Literal value = Literal::slot(processLocals[i].type);
+        switch (processLocals[i].type)
+        {
+        case LiteralType::INT:
+            value.setInt((long)processLocals[i].initial);
+            break;
+        case LiteralType::FLOAT:
+            value.setFloat(processLocals[i].initial);
+            break;
+        case LiteralType::BYTE:
+            value.setByte((unsigned char)processLocals[i].initial);
+            break;
+        case LiteralType::BOOLEAN:
+            value.setBool(processLocals[i].initial != 0);
+            break;
+        default:
+            break;
+        }
+        builtins.push_back(value);
+    }
+    processDefaults = std::make_shared<Environment>(0, nullptr);
+    processDefaults->setBuiltins(builtins);
+
+    mainState.environmentStack.push(mainEnvironment);
 
    
 #if defined(__LP64__) || defined(_WIN64)
@@ -46,7 +83,19 @@ void Interpreter::init()
 
 
     BlockID = 0;
-    context = std::make_shared<ExecutionContext>(this);
+    schedulerStats = SchedulerStats();
+    frameNumber = 0;
+    frameTime = 0;
+    gameTime = 0;
+    frameBudget = 0;
+    tickBudget = 0;
+    budgetKill = false;
+    deferFrom = 0;
+    frameTimes.assign(FrameHistory, 0.0);
+    mainCursor = {-1, 0};
+    mainState.context = std::make_shared<ExecutionContext>(this);
+    heap.markRoots = [this](Heap &heap) { markRoots(heap); };
+    processes.recycle = [this](std::unique_ptr<Process> process) { recycleProcess(std::move(process)); };
     panicMode = false;
     start_time = std::chrono::high_resolution_clock::now();
     time_elapsed();
@@ -57,27 +106,40 @@ void Interpreter::cleanup()
 {
 
     Log(0, "Release Interpreter");
-    while(environmentStack.empty()==false)
+    jobs.stop();
+    workerStates.clear();
+    while(mainState.environmentStack.empty()==false)
     {
-        environmentStack.pop();
+        mainState.environmentStack.pop();
     }
 
     processes.clear();
+    processPools.clear();
+    frameWheel.clear();
+    interrupted.clear();
+    timeWheel.clear();
     procedureList.clear();
     functionList.clear();
     nativeFunctions.clear();     
     processExecuter.clear();
     processListNames.clear();
     processList.clear();
-    currentDepth = 0;
+    mainState.currentDepth = 0;
     program=nullptr;
-    context=nullptr;
-    mainEnvironment = nullptr;
+    mainState.context=nullptr;
     mainEnvironment = nullptr;
+    processDefaults = nullptr;
+    heap.clear();
     
 
 }
 
+void Interpreter::setRandomSeed(uint64_t seed)
+{
+    randomSeed = seed;
+    mainStream.seed(seed, 0);
+}
+
 double Interpreter::time_elapsed()
 {
     auto now = std::chrono::high_resolution_clock::now();
@@ -148,31 +210,35 @@ void Interpreter::execute(Stmt *statement)
         Error("execute null statement");
         return;
     }
+    countStep();
     statement->accept(this);
 }
 
 void Interpreter::enterBlock()
 {
-    this->currentDepth++;
-    auto newEnv = std::make_shared<Environment>(this->currentDepth, environmentStack.top());
-    environmentStack.push(newEnv);
+    ExecutionState &exec = state();
+    exec.currentDepth++;
+    auto newEnv = std::make_shared<Environment>(exec.currentDepth, exec.environmentStack.top());
+    exec.environmentStack.push(newEnv);
 
 }
 
 void Interpreter::enterLocal(const std::shared_ptr<Environment> &env)
 {
-    this->currentDepth++;
-    environmentStack.push(env);
+    ExecutionState &exec = state();
+    exec.currentDepth++;
+    exec.environmentStack.push(env);
 
 
 }
 
 void Interpreter::exitBlock()
 { 
-        if (environmentStack.size() > 1) 
+        ExecutionState &exec = state();
+        if (exec.environmentStack.size() > 1) 
         {
-            environmentStack.pop();
-            this->currentDepth--;
+            exec.environmentStack.pop();
+            exec.currentDepth--;
         } else 
         {
             Warning("Environment stack underflow");
@@ -182,7 +248,7 @@ void Interpreter::exitBlock()
 
 std::shared_ptr<Environment> Interpreter::currentEnvironment()
 {
-    return environmentStack.top();
+    return state().environmentStack.top();
 }
 
 
@@ -236,6 +302,7 @@ void Interpreter::execute(const std::shared_ptr<Stmt> &stmt)
     if (stmt == nullptr)
         return;
    // std::cout << "execute: " << stmt->toString() << std::endl;
+    countStep();
     stmt->accept(this);
 
 }
@@ -244,16 +311,18 @@ void Interpreter::visitBlockStmt(BlockStmt *stmt)
 {
 
     enterBlock();
-    for (const auto &stmt : stmt->declarations)
+    try
     {
-        try
+        for (const auto &stmt : stmt->declarations)
         {
             execute(stmt);
         }
-        catch (ReturnException &returnValue)
-        {
-            break;
-        }
+    }
+    catch (...)
+    {
+        // break, continue and return leave the block too
+        exitBlock();
+        throw;
     }
 
     exitBlock();
@@ -288,32 +357,45 @@ void Interpreter::visitBlockStmt(BlockStmt *stmt)
 bool Interpreter::run()
 {
 
+    Memory::nextFrame();
+    frameNumber++;
+    frameTime = time_elapsed();
+    gameTime = fixedStep > 0 ? (frameNumber - 1) * fixedStep * 1000.0 : frameTime;
+    wakeSleepers();
+    ExecutionContext *context = mainState.context.get();
     context->currentProcess = nullptr;
-    for (size_t i = 0; i < processes.size(); i++)
-    {
-      
-        if (!processes[i]->running())
+    // processes spawned during the frame are appended and run this frame too,
+    // runs of parallel safe processes are handed to the workers
+    bool budgeted = frameBudget > 0;
+    deferQueue.clear();
+    for (size_t i = 0; i < processes.size();)
+    {
+        size_t end = parallelSegment(i);
+        if (end > i)
         {
-            remove_processes.push_back(std::move(processes[i]));
-            processes.erase(processes.begin() + i);
-            i--;
+            tickParallel(i, end);
+            i = end;
             continue;
         }
-
-        context->currentProcess = processes[i].get();
-        
-        context->internalProcess = processes[i].get();
-        processes[i]->run();
-        
-        
-
-  
-
-      
+        Process *process = processes.at(i++);
+        if (budgeted && processExecuter[process->index]->deferrable)
+        {
+            deferQueue.push_back(process);
+            continue;
+        }
+        tickProcess(process, context);
+    }
+    if (!deferQueue.empty())
+    {
+        tickDeferred(context);
     }
     context->currentProcess = nullptr;
+    context->internalProcess = nullptr;
     
-    remove_processes.clear();
+    parkSleepers();
+
+    heap.step();
+    recordFrame(time_elapsed() - frameTime);
     
 
 
@@ -323,6 +405,41 @@ bool Interpreter::run()
     return true;
 }
 
+void Interpreter::markRoots(Heap &heap)
+{
+    if (mainEnvironment)
+    {
+        mainEnvironment->mark(heap);
+    }
+    if (!mainState.environmentStack.empty())
+    {
+        mainState.environmentStack.top()->mark(heap);
+    }
+    processes.forEach([&heap](Process *process)
+    {
+        if (process->environment)
+        {
+            process->environment->mark(heap);
+        }
+        for (auto &frame : process->frames)
+        {
+            frame.env->mark(heap);
+        }
+        process->mailbox.forEach([&heap](const Message &message) { heap.shade(message.value); });
+        for (auto &message : process->inbox)
+        {
+            heap.shade(message.value);
+        }
+    });
+    if (mainState.context)
+    {
+        for (auto &value : mainState.context->values)
+        {
+            heap.shade(value);
+        }
+    }
+}
+
 void Interpreter::visitPrintStmt(PrintStmt *stmt)
 {
 
@@ -378,6 +495,14 @@ std::shared_ptr<Expr> Interpreter::visitVariableExpr(VariableExpr *expr)
     {
         return Factory::Instance().createFloatLiteral(value->getFloat());
     }
+    else if (value->getType() == LiteralType::BYTE)
+    {
+        return Factory::Instance().createByteLiteral(value->getByte());
+    }
+    else if (value->getType() == LiteralType::OBJECT)
+    {
+        return Factory::Instance().createObjectLiteral(value->getObject());
+    }
     else 
     {
         Error("Load variable  '" + name + "' is null at line: " + std::to_string(line)+" type:"+ value->toString());
@@ -393,9 +518,9 @@ std::shared_ptr<Expr> Interpreter::visitAssignExpr(AssignExpr *expr)
     std::string name = expr->name.lexeme;
 
     auto value = evaluate(expr->value);
-    Literal *oldLiteral = this->currentEnvironment()->get(name);
+    Literal *slot = this->currentEnvironment()->get(name);
 
-    if (!value || !oldLiteral)
+    if (!value || !slot)
     {
         Error(expr->name, "Can Assign, variable  '" + name + "' ");
         return std::make_shared<EmptyExpr>();
@@ -406,21 +531,28 @@ std::shared_ptr<Expr> Interpreter::visitAssignExpr(AssignExpr *expr)
     if (value->getType() == ExprType::LITERAL)
     {
 
-        LiteralExpr *literal = dynamic_cast<LiteralExpr *>(value.get());
-        if (!literal)
+        LiteralExpr *literal = static_cast<LiteralExpr *>(value.get());
+
+        // the parser already converted constants to the slot type
+        if (slot->getType() == literal->value.getType())
         {
-            Error(expr->name, "Can Assign, variable  '" + name + "' ");
-            return std::make_shared<EmptyExpr>();
+            slot->store(literal->value);
         }
-        
-
-      
-     
-        if (!this->currentEnvironment()->assign(name, literal->value))
+        else if (!slot->assign(literal->value))
         {
             Error(expr->name, "Assign variable  '" + name + "'" );
             return std::make_shared<EmptyExpr>();
         }
+        // x = ... in a process body, the instance takes it after the pass
+        Process *process = state().context->currentProcess;
+        if (process && process->environment)
+        {
+            int builtin = process->environment->builtinSlot(slot);
+            if (builtin >= 0)
+            {
+                process->touch(builtin);
+            }
+        }
 
       
     }
@@ -432,6 +564,86 @@ std::shared_ptr<Expr> Interpreter::visitAssignExpr(AssignExpr *expr)
     return value;
 }
 
+// A field of another process: a built-in is read from its slot, a local the
+// type declares through the field id the parser gave the name. A stale id or
+// a local the body has not declared yet has no field, reads give 0 and
+// writes are dropped.
+Literal *Interpreter::processField(FieldExpr *expr, Process **owner)
+{
+    auto object = evaluate(expr->object);
+    if (!object || object->getType() != ExprType::LITERAL)
+    {
+        Error(expr->name, "Field '" + expr->name.lexeme + "' of a value that is not a process");
+        return nullptr;
+    }
+    Process *process = processes.find(static_cast<LiteralExpr *>(object.get())->value.getInt());
+    if (!process || !process->environment)
+    {
+        return nullptr;
+    }
+    if (owner)
+    {
+        *owner = process;
+    }
+    if (expr->slot >= 0)
+    {
+        return &process->environment->builtin(expr->slot);
+    }
+    ProcessExecution *type = processExecuter[process->index].get();
+    int local = expr->field >= 0 && expr->field < (int)type->fields.size() ? type->fields[expr->field] : -1;
+    if (local < 0)
+    {
+        Error(expr->name, "Process '" + process->getName() + "' has no local '" + expr->name.lexeme + "'");
+        return nullptr;
+    }
+    Literal *&value = process->fields[local];
+    if (!value)
+    {
+        value = process->environment->local(type->locals[local]);
+    }
+    return value;
+}
+
+std::shared_ptr<Expr> Interpreter::visitFieldExpr(FieldExpr *expr)
+{
+    Literal *value = processField(expr);
+    if (!value)
+    {
+        return Factory::Instance().createIntegerLiteral(0);
+    }
+    return Factory::Instance().createLiteral(*value);
+}
+
+std::shared_ptr<Expr> Interpreter::visitFieldAssignExpr(FieldAssignExpr *expr)
+{
+    auto value = evaluate(expr->value);
+    Process *process = nullptr;
+    Literal *slot = processField(expr->field.get(), &process);
+    if (!value || !slot)
+    {
+        return value;
+    }
+    if (value->getType() != ExprType::LITERAL)
+    {
+        Warning("Cannot assign non-literal expression");
+        return value;
+    }
+    LiteralExpr *literal = static_cast<LiteralExpr *>(value.get());
+    if (slot->getType() == literal->value.getType())
+    {
+        slot->store(literal->value);
+    }
+    else if (!slot->assign(literal->value))
+    {
+        Error(expr->field->name, "Assign field '" + expr->field->name.lexeme + "'");
+    }
+    if (expr->field->slot >= 0)
+    {
+        process->touch(expr->field->slot);
+    }
+    return value;
+}
+
 void Interpreter::visitVarStmt(VarStmt *stmt) /// define variables
 {
 
@@ -447,14 +659,25 @@ void Interpreter::visitVarStmt(VarStmt *stmt) /// define variables
 
     if (value->getType() == ExprType::LITERAL)
     {
-        LiteralExpr *literal = dynamic_cast<LiteralExpr *>(value.get());
+        LiteralExpr *literal = static_cast<LiteralExpr *>(value.get());
+
+        // the slot keeps the declared type
+        Literal slot = literal->value;
+        if (slot.getType() != stmt->type)
+        {
+            slot = Literal::slot(stmt->type);
+            if (!slot.assign(literal->value))
+            {
+                Warning("Cannot initialize variable '" + stmt->names[0].lexeme + "' at line: " + std::to_string(stmt->names[0].line));
+            }
+        }
 
         for (auto &token : stmt->names)
         {
             std::string name = token.lexeme;
         
 
-            if (!this->currentEnvironment()->define(name, literal->value))
+            if (!this->currentEnvironment()->define(name, slot))
             {
                 Warning("Variable '" + name + "' already defined at line: " + std::to_string(token.line));
             } 
@@ -489,6 +712,7 @@ void Interpreter::visitProgram(Program *stmt)
             break;
         }
     }
+    classifyProcesses();
     try
     {
         execute(stmt->statement);
@@ -569,8 +793,14 @@ void Interpreter::visitProcedureCallStmt(ProcedureCallStmt *stmt)
     }
 
 
-    this->execute(procedure->body);
-  ;
+    try
+    {
+        this->execute(procedure->body);
+    }
+    catch (ReturnException &)
+    {
+    }
+    exitBlock();
 }
 
 
@@ -602,7 +832,7 @@ std::shared_ptr<Expr> Interpreter::callFunction(CallerExpr *expr)
         Error("Incorrect number of arguments passed to function '" + name + "' at line: " + std::to_string(expr->line) + " expected: " + std::to_string(numArgsExpectd) + " got: " + std::to_string(numArgs));
         return std::make_shared<EmptyExpr>();
     }
-    this->currentDepth++;
+    state().currentDepth++;
     enterBlock();
 
 
@@ -680,7 +910,10 @@ std::shared_ptr<Expr> Interpreter::callNativeFunction(CallerExpr *expr)
         return std::make_shared<EmptyExpr>();
     }
 
-    this->context.get()->values.clear();
+    // arguments may be native calls themselves, collect them before
+    // handing the shared context over
+    std::vector<Literal> args;
+    args.reserve(expr->parameters.size());
 
     unsigned int numArgs = expr->parameters.size();
     for (const auto &arg : expr->parameters)
@@ -703,13 +936,17 @@ std::shared_ptr<Expr> Interpreter::callNativeFunction(CallerExpr *expr)
        // Log(0, "Native function argument: %s", exprValue->toString().c_str());
 
        if (exprValue->getType() == LiteralType::INT)
-          this->context.get()->add(Literal(exprValue->getInt()));
+          args.push_back(Literal(exprValue->getInt()));
        else if (exprValue->getType() == LiteralType::FLOAT)
-          this->context.get()->add(Literal(exprValue->getFloat()));
+          args.push_back(Literal(exprValue->getFloat()));
        else if (exprValue->getType() == LiteralType::BOOLEAN)
-          this->context.get()->add(Literal(exprValue->getBool()));
+          args.push_back(Literal(exprValue->getBool()));
        else if (exprValue->getType() == LiteralType::STRING)
-          this->context.get()->add(Literal(exprValue->getString()));
+          args.push_back(Literal(exprValue->getString()));
+       else if (exprValue->getType() == LiteralType::OBJECT)
+          args.push_back(Literal(exprValue->getObject()));
+       else if (exprValue->getType() == LiteralType::BYTE)
+          args.push_back(Literal(exprValue->getByte()));
        else
        {
            Error("Invalid argument passed to function '" + name + "' at line: " + std::to_string(line));
@@ -717,9 +954,16 @@ std::shared_ptr<Expr> Interpreter::callNativeFunction(CallerExpr *expr)
        }
     }
 
+    ExecutionContext *context = state().context.get();
+    context->values.clear();
+    for (auto &value : args)
+    {
+        context->add(value);
+    }
+
      auto function = nativeFunctions[name];
 
-     LiteralPtr result = function(this->context.get(), numArgs);
+     LiteralPtr result = function(context, numArgs);
 
      if (!result)
     {
@@ -727,13 +971,17 @@ std::shared_ptr<Expr> Interpreter::callNativeFunction(CallerExpr *expr)
         return std::make_shared<EmptyExpr>();
     }
     if (result->getType() == LiteralType::INT)
-        return std::make_shared<LiteralExpr>(result->getInt());
+        return Factory::Instance().createIntegerLiteral(result->getInt());
     else if (result->getType() == LiteralType::FLOAT)
-        return std::make_shared<LiteralExpr>(result->getFloat());
+        return Factory::Instance().createFloatLiteral(result->getFloat());
     else if (result->getType() == LiteralType::BOOLEAN)
-        return std::make_shared<LiteralExpr>(result->getBool());
+        return Factory::Instance().createBoolLiteral(result->getBool());
     else if (result->getType() == LiteralType::STRING)
-        return std::make_shared<LiteralExpr>(result->getString());
+        return Factory::Instance().createStringLiteral(result->getString());
+    else if (result->getType() == LiteralType::OBJECT)
+        return Factory::Instance().createObjectLiteral(result->getObject());
+    else if (result->getType() == LiteralType::BYTE)
+        return Factory::Instance().createByteLiteral(result->getByte());
     else
     {
         Error("Invalid return value from native function '" + name + "' .");
@@ -747,7 +995,6 @@ std::shared_ptr<Expr> Interpreter::callProcess(CallerExpr *expr)
 
     const std::string name = expr->name;
     int line = expr->line - 1;
-    long id =(long) processID++;
     ProcessStmt *process = processList[name];
     if (!process)
     {
@@ -765,46 +1012,18 @@ std::shared_ptr<Expr> Interpreter::callProcess(CallerExpr *expr)
         Error("Incorrect number of arguments passed to process '" + name + "' at line: " + std::to_string(line) + " expected: " + std::to_string(numArgsExpectd) + " got: " + std::to_string(numArgs));
         return std::make_shared<EmptyExpr>();
     }
-    this->currentDepth++;
-
-  
- 
-
-    std::unique_ptr<Process> newProcess = std::make_unique<Process>(this, name, id,index);
-
-    if (context->internalProcess==nullptr)
+    long id = processes.allocate();
+    if (id == 0)
     {
-        context->internalProcess = newProcess.get();
+        Error("Cannot spawn process '" + name + "' at line: " + std::to_string(line));
+        return Factory::Instance().createIntegerLiteral(0);
     }
+    state().currentDepth++;
 
+  
+ 
 
-     newProcess->environment =std::make_shared<Environment>(this->currentDepth, this->currentEnvironment());
-     newProcess->environment->addInteger("id", id);
-     newProcess->environment->addInteger("graph", 0);
-     newProcess->environment->addInteger("layer", 0);
-
-     newProcess->environment->addFloat("x", 0.0);
-     newProcess->environment->addFloat("y", 0.0);
-     newProcess->environment->addFloat("angle", 0.0);
-
-     newProcess->environment->addFloat("scale_x", 1.0);
-     newProcess->environment->addFloat("scale_y", 1.0);
-
-     newProcess->environment->addFloat("skew_x", 0.0);
-     newProcess->environment->addFloat("skew_y", 0.0);
-     
-     newProcess->environment->addByte("red", 255);
-     newProcess->environment->addByte("green", 255);
-     newProcess->environment->addByte("blue", 255);
-     newProcess->environment->addByte("alpha", 255);
-
-     newProcess->environment->addBool("show_box", false);
-     newProcess->environment->addBool("show_pivot", false);
-     
-     newProcess->environment->addBool("active", true);
-     newProcess->environment->addBool("visible", true);
-     
-    
+    std::unique_ptr<Process> newProcess = createProcess(index, name, id);
 
     for (unsigned int i = 0; i < numArgs; i++)
     {
@@ -827,15 +1046,142 @@ std::shared_ptr<Expr> Interpreter::callProcess(CallerExpr *expr)
         else
         {
             Error("Invalid argument passed to process '" + name + "" + value->toString());
+            newProcess->kill();
+            recycleProcess(std::move(newProcess));
+            processes.release(id);
             return Factory::Instance().createIntegerLiteral(-1);
         }
     }
 
 
-    processes.push_back(std::move(newProcess));
+    processes.insert(std::move(newProcess));
     return Factory::Instance().createIntegerLiteral(id);
 }
 
+// a pooled or new process of one type with fresh built-in locals
+std::unique_ptr<Process> Interpreter::createProcess(size_t index, const std::string &name, long id)
+{
+    std::unique_ptr<Process> process = acquireProcess(index, name, id);
+
+    ExecutionContext *context = state().context.get();
+    if (context->internalProcess==nullptr)
+    {
+        context->internalProcess = process.get();
+    }
+
+    if (!process->environment)
+    {
+        process->environment = std::make_shared<Environment>(state().currentDepth, this->currentEnvironment());
+    }
+    process->environment->reset(state().currentDepth, this->currentEnvironment(), *processDefaults);
+    process->fields.assign(processExecuter[index]->locals.size(), nullptr);
+    process->environment->builtin(LOCAL_ID).setInt(id);
+    process->environment->builtin(LOCAL_TICK_RATE).setFloat(processExecuter[index]->tickRate);
+    adopt(process.get());
+    return process;
+}
+
+// DIV style family ids: the spawning process becomes the father, its last
+// son the new one's bigbro. They are plain ids, a relative that finished
+// stops resolving instead of pointing at a newer process.
+void Interpreter::adopt(Process *process)
+{
+    Process *father = state().context->currentProcess;
+    if (!father || !father->environment)
+    {
+        return;
+    }
+    Literal *child = &process->environment->builtin(0);
+    Literal *family = &father->environment->builtin(0);
+    long bigbro = family[LOCAL_SON].getInt();
+    process->parent = father;
+    child[LOCAL_FATHER].setInt(father->ID);
+    child[LOCAL_BIGBRO].setInt(bigbro);
+    family[LOCAL_SON].setInt(process->ID);
+    if (Process *older = processes.find(bigbro))
+    {
+        older->environment->builtin(LOCAL_SMALLBRO).setInt(process->ID);
+    }
+}
+
+size_t Interpreter::spawnMany(const std::string &typeName, size_t count, const std::vector<Literal> &arguments, std::vector<long> *ids)
+{
+    // script identifiers are lower case
+    std::string name = typeName;
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+    auto it = processList.find(name);
+    if (it == processList.end() || !it->second)
+    {
+        Error("Process '" + name + "' not defined");
+        return 0;
+    }
+    ProcessStmt *process = it->second;
+    if (arguments.size() != process->parameter.size())
+    {
+        Error("Incorrect number of arguments passed to process '" + name + "' expected: " + std::to_string(process->parameter.size()) + " got: " + std::to_string(arguments.size()));
+        return 0;
+    }
+    size_t index = processListNames[name];
+
+    // the arguments are converted to the parameter types once for the batch
+    std::vector<Literal> values(arguments.size());
+    std::vector<ListObject *> spread(arguments.size(), nullptr);
+    for (size_t i = 0; i < arguments.size(); i++)
+    {
+        LiteralType type = process->parameter[i]->expression->value.getType();
+        HeapObject *object = arguments[i].isObject() ? arguments[i].getObject() : nullptr;
+        if (type != LiteralType::OBJECT && object && object->getType() == HEAP_LIST &&
+            !static_cast<ListObject *>(object)->items.empty())
+        {
+            spread[i] = static_cast<ListObject *>(object);
+            continue;
+        }
+        values[i] = Literal::slot(type);
+        values[i].assign(arguments[i]);
+    }
+
+    processes.reserve(count);
+    Scene::Get().ReserveInstances(count);
+    if (ids)
+    {
+        ids->reserve(ids->size() + count);
+    }
+    state().currentDepth++;
+
+    size_t spawned = 0;
+    for (; spawned < count; spawned++)
+    {
+        long id = processes.allocate();
+        if (id == 0)
+        {
+            Warning("Cannot spawn more than " + std::to_string(spawned) + " of " + std::to_string(count) + " '" + name + "'");
+            break;
+        }
+        std::unique_ptr<Process> newProcess = createProcess(index, name, id);
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            const std::string &argName = process->parameter[i]->name;
+            Literal value = values[i];
+            if (spread[i])
+            {
+                const auto &items = spread[i]->items;
+                value = Literal::slot(process->parameter[i]->expression->value.getType());
+                value.assign(items[spawned % items.size()]);
+            }
+            if (!newProcess->define(argName, value))
+            {
+                newProcess->environment->assign(argName, value);
+            }
+        }
+        if (ids)
+        {
+            ids->push_back(id);
+        }
+        processes.insert(std::move(newProcess));
+    }
+    return spawned;
+}
+
 int Interpreter::CallerType(const std::string &name)
 {
     if (processList.find(name) != processList.end())
@@ -890,6 +1236,83 @@ void Interpreter::visitFunctionStmt(FunctionStmt *stmt)
     functionList[stmt->name] = stmt;
 }
 
+static bool isLoop(const Stmt *stmt)
+{
+    StmtType type = stmt->getType();
+    return type == StmtType::LOOP || type == StmtType::WHILE || type == StmtType::REPEAT || type == StmtType::FOR;
+}
+
+static bool isCompound(const Stmt *stmt)
+{
+    StmtType type = stmt->getType();
+    return isLoop(stmt) || type == StmtType::BLOCK || type == StmtType::IF || type == StmtType::SWITCH;
+}
+
+// sleep(ms); and wait_frames(n); written as statements suspend right after
+static bool isSleepCall(Expr *expr)
+{
+    if (!expr || expr->getType() != ExprType::CALLER)
+        return false;
+    CallerExpr *call = static_cast<CallerExpr *>(expr);
+    return call->caller == 2 && (call->name == "sleep" || call->name == "wait_frames");
+}
+
+// flag every statement that can reach a frame or a sleep, those are stepped
+// by the process scheduler, the rest run straight through execute()
+static bool markYields(Stmt *stmt, bool &frames)
+{
+    if (!stmt)
+        return false;
+    bool yields = false;
+    switch (stmt->getType())
+    {
+    case StmtType::FRAME:
+        yields = true;
+        frames = true;
+        break;
+    case StmtType::EXPRESSION:
+        yields = isSleepCall(static_cast<ExpressionStmt *>(stmt)->expression.get());
+        break;
+    case StmtType::BLOCK:
+        for (auto &child : static_cast<BlockStmt *>(stmt)->declarations)
+            yields |= markYields(child.get(), frames);
+        break;
+    case StmtType::IF:
+    {
+        IfStmt *branch = static_cast<IfStmt *>(stmt);
+        yields |= markYields(branch->thenBranch.get(), frames);
+        for (auto &elif : branch->elifBranch)
+            yields |= markYields(elif->thenBranch.get(), frames);
+        yields |= markYields(branch->elseBranch.get(), frames);
+        break;
+    }
+    case StmtType::SWITCH:
+    {
+        SwitchStmt *branch = static_cast<SwitchStmt *>(stmt);
+        for (auto &caseStmt : branch->cases)
+            yields |= markYields(caseStmt->body.get(), frames);
+        yields |= markYields(branch->default_case.get(), frames);
+        break;
+    }
+    case StmtType::WHILE:
+        yields = markYields(static_cast<WhileStmt *>(stmt)->body.get(), frames);
+        break;
+    case StmtType::LOOP:
+        yields = markYields(static_cast<LoopStmt *>(stmt)->body.get(), frames);
+        break;
+    case StmtType::REPEAT:
+        yields = markYields(static_cast<RepeatStmt *>(stmt)->body.get(), frames);
+        break;
+    case StmtType::FOR:
+        yields = markYields(static_cast<ForStmt *>(stmt)->body.get(), frames);
+        break;
+    default:
+        break;
+    }
+    stmt->yields = yields;
+    return yields;
+}
+
 void Interpreter::visitProcessStmt(ProcessStmt *stmt)
 {
     if (procedureList.find(stmt->name) != procedureList.end())
@@ -907,104 +1330,335 @@ void Interpreter::visitProcessStmt(ProcessStmt *stmt)
     std::shared_ptr<ProcessExecution> process = std::make_shared<ProcessExecution>();
     process->name = stmt->name;
     process->index = index;
-    bool isEnds = false;
-
-    BlockStmt *block = dynamic_cast<BlockStmt *>(stmt->body.get());
-    for (auto &stmt : block->declarations)
-    {
-            if (stmt->getType() == StmtType::LOOP)
-            {
-                    LoopStmt *loop  = dynamic_cast<LoopStmt *>(stmt.get());
-                    BlockStmt *child = dynamic_cast<BlockStmt *>(loop->body.get());
-                    process->loopStatements.push_back(child);
-
-                    isEnds = true;
-                    continue;
-            }
-            if (isEnds)
-            {
-                process->finalStatements.push_back(stmt);
-            } else 
-            {
-                process->initialStatements.push_back(stmt);
-            }
-    }
+    process->body = dynamic_cast<BlockStmt *>(stmt->body.get());
+    bool frames = false;
+    markYields(process->body, frames);
+    process->implicitFrame = !frames;
+    process->parallel = false;
+    process->tickRate = 0;
+    process->deferrable = false;
+    process->locals = stmt->locals;
+    process->fields = stmt->fields;
     processExecuter.push_back(std::move(process)); 
 }
 
+void Interpreter::visitFrameStmt(FrameStmt *stmt)
+{
+    Error("frame outside of a process body");
+}
 
-bool Interpreter::processInitExecute(size_t index)
+// Start the statement from the top frame. Statements that cannot reach a
+// frame run to completion, the others are pushed and stepped.
+// Returns true when the process has to wait for the next frame.
+bool Interpreter::enterFrame(Process *process, Stmt *stmt, bool implicitFrame)
 {
-    if (index >= processExecuter.size())
+    std::vector<ProcessFrame> &frames = process->frames;
+    if (stmt->getType() == StmtType::FRAME)
     {
-        return false;
+        FrameStmt *wait = static_cast<FrameStmt *>(stmt);
+        process->framePercent = 100;
+        if (wait->percent)
+        {
+            std::shared_ptr<Expr> value = evaluate(wait->percent);
+            LiteralExpr *percent = dynamic_cast<LiteralExpr *>(value.get());
+            if (!percent)
+            {
+                Error("invalid frame percent");
+            }
+            process->framePercent = std::max(1L, percent->value.getInt());
+        }
+        return true;
     }
-    std::shared_ptr<ProcessExecution> action = processExecuter[index];
-    for (auto &stmt : action->initialStatements)
+    bool mainLoop = implicitFrame && frames.size() == 1 && stmt->getType() == StmtType::LOOP;
+    // under a tick budget every loop is stepped, so it can be preempted
+    bool preemptible = tickBudget > 0 && !budgetKill && isCompound(stmt);
+    if (!stmt->yields && !mainLoop && !preemptible)
     {
         execute(stmt);
+        return false;
     }
-    return true;
-}
-bool Interpreter::processEndExecute(size_t index)
-{
-    if (index >= processExecuter.size())
+    countStep();
+
+    switch (stmt->getType())
     {
+    case StmtType::BLOCK:
+    {
+        const std::shared_ptr<Environment> &parent = frames.back().env;
+        frames.push_back({stmt, 0, std::make_shared<Environment>(parent->getDepth() + 1, parent)});
         return false;
     }
-    std::shared_ptr<ProcessExecution> action = processExecuter[index];
-    for (auto &stmt : action->finalStatements)
+    case StmtType::IF:
     {
-        execute(stmt);
+        Stmt *branch = selectBranch(static_cast<IfStmt *>(stmt));
+        return branch ? enterFrame(process, branch, implicitFrame) : false;
     }
-    return true;
-    
-}
-bool Interpreter::processLoopExecute(size_t index)
-{
-    if (index >= processExecuter.size())
+    case StmtType::SWITCH:
     {
-        return false;
+        Stmt *branch = selectCase(static_cast<SwitchStmt *>(stmt));
+        return branch ? enterFrame(process, branch, implicitFrame) : false;
     }
-    std::shared_ptr<ProcessExecution> action = processExecuter[index];
-    for (auto &stmt : action->loopStatements)
-    {
+    case StmtType::EXPRESSION:
+        // a sleep, resumeProcess() sees the process asleep and suspends it
         execute(stmt);
+        return false;
+    default:
+        frames.push_back({stmt, 0, frames.back().env});
+        return false;
     }
-    return true;
 }
 
-
-void Interpreter::visitReturnStmt(ReturnStmt *stmt)
+// Advance the top frame by one statement or loop pass.
+bool Interpreter::stepFrame(Process *process, bool implicitFrame)
 {
-
-    std::shared_ptr<Expr> value = evaluate(stmt->value);
-    if (!value)
+    std::vector<ProcessFrame> &frames = process->frames;
+    ProcessFrame &frame = frames.back();
+    switch (frame.stmt->getType())
     {
-        Error("RETURN: invalid  value ");
-    }
+    case StmtType::BLOCK:
+    {
+        BlockStmt *block = static_cast<BlockStmt *>(frame.stmt);
+        if (frame.pc >= block->declarations.size())
+        {
+            frames.pop_back();
+            return false;
+        }
+        return enterFrame(process, block->declarations[frame.pc++].get(), implicitFrame);
+    }
+    case StmtType::LOOP:
+    {
+        LoopStmt *loop = static_cast<LoopStmt *>(frame.stmt);
+        if (frame.pc == 1 && implicitFrame)
+        {
+            frame.pc = 0;
+            process->framePercent = 100;
+            return true;
+        }
+        frame.pc = 1;
+        return enterFrame(process, loop->body.get(), implicitFrame);
+    }
+    case StmtType::WHILE:
+    {
+        WhileStmt *loop = static_cast<WhileStmt *>(frame.stmt);
+        if (!isTruthy(evaluate(loop->condition)))
+        {
+            frames.pop_back();
+            return false;
+        }
+        return enterFrame(process, loop->body.get(), implicitFrame);
+    }
+    case StmtType::REPEAT:
+    {
+        RepeatStmt *loop = static_cast<RepeatStmt *>(frame.stmt);
+        if (frame.pc == 1 && isTruthy(evaluate(loop->condition)))
+        {
+            frames.pop_back();
+            return false;
+        }
+        frame.pc = 1;
+        return enterFrame(process, loop->body.get(), implicitFrame);
+    }
+    case StmtType::FOR:
+    {
+        ForStmt *loop = static_cast<ForStmt *>(frame.stmt);
+        if (frame.pc == 0)
+        {
+            if (loop->initializer)
+                execute(loop->initializer);
+        }
+        else if (loop->step)
+        {
+            evaluate(loop->step);
+        }
+        if (loop->condition && !isTruthy(evaluate(loop->condition)))
+        {
+            frames.pop_back();
+            return false;
+        }
+        frame.pc = 1;
+        return enterFrame(process, loop->body.get(), implicitFrame);
+    }
+    default:
+        frames.pop_back();
+        return false;
+    }
+}
+
+// break leaves the innermost loop, continue goes back to its test
+static void unwindLoop(std::vector<ProcessFrame> &frames, bool leave)
+{
+    while (!frames.empty())
+    {
+        if (isLoop(frames.back().stmt))
+        {
+            if (leave)
+                frames.pop_back();
+            return;
+        }
+        frames.pop_back();
+    }
+}
+
+// A sleep that ends the pass of a legacy main loop stands in for the frame
+// the pass would end with, the loop starts its next pass on wake up.
+static void skipImplicitFrame(std::vector<ProcessFrame> &frames)
+{
+    size_t top = frames.size();
+    while (top > 2 && frames[top - 1].stmt->getType() == StmtType::BLOCK &&
+           frames[top - 1].pc >= static_cast<BlockStmt *>(frames[top - 1].stmt)->declarations.size())
+    {
+        top--;
+    }
+    if (top == 2 && frames[1].stmt->getType() == StmtType::LOOP)
+    {
+        frames.resize(2);
+        frames[1].pc = 0;
+    }
+}
+
+// The statement budget of one resume, lifted on the way out whatever unwinds.
+struct StepBudget
+{
+    ExecutionState &exec;
+
+    StepBudget(ExecutionState &exec, long limit) : exec(exec)
+    {
+        exec.steps = 0;
+        exec.stepLimit = limit;
+    }
+    ~StepBudget() { exec.stepLimit = 0; }
+};
+
+// Run the process until its next frame statement or until the body ends.
+// Returns false once the process has finished.
+//
+// With a tick budget the process is counted a step per statement and loop
+// pass. Past the budget it stops before its next step and resumes there next
+// frame. A statement that does not return to the body, a call stuck in a
+// loop, can not be stopped halfway, it is killed after a second budget. In
+// kill mode the process dies as soon as it goes over.
+bool Interpreter::resumeProcess(Process *process)
+{
+    if (process->index >= processExecuter.size())
+    {
+        return false;
+    }
+    ProcessExecution *action = processExecuter[process->index].get();
+    std::vector<ProcessFrame> &frames = process->frames;
+    if (!process->started)
+    {
+        process->started = true;
+        frames.push_back({action->body, 0, process->environment});
+    }
+    if (frames.empty())
+    {
+        return false;
+    }
+
+    ExecutionState &exec = state();
+    size_t depth = exec.environmentStack.size();
+    StepBudget budget(exec, budgetKill ? tickBudget : tickBudget * 2);
+    enterLocal(frames.back().env);
+    bool suspended = false;
+    while (!frames.empty() && process->running())
+    {
+        try
+        {
+            if (tickBudget > 0 && !budgetKill && exec.steps >= tickBudget)
+            {
+                exec.preempted++;
+                process->framePercent = 100;
+                suspended = true;
+                break;
+            }
+            suspended = stepFrame(process, action->implicitFrame);
+        }
+        catch (BudgetException &)
+        {
+            exec.budgetKills++;
+            Log(2, "Process %s (%ld) ran past its tick budget of %ld statements, killed", action->name.c_str(),
+                process->ID, tickBudget);
+            // calls left their scopes behind on the way out
+            while (exec.environmentStack.size() > depth + 1)
+            {
+                exec.environmentStack.pop();
+                exec.currentDepth--;
+            }
+            frames.clear();
+        }
+        catch (BreakException &)
+        {
+            unwindLoop(frames, true);
+        }
+        catch (ContinueException &)
+        {
+            unwindLoop(frames, false);
+        }
+        catch (ReturnException &)
+        {
+            frames.clear();
+        }
+        if (frames.empty())
+        {
+            break;
+        }
+        if (!suspended && process->sleeping())
+        {
+            if (action->implicitFrame)
+            {
+                skipImplicitFrame(frames);
+            }
+            suspended = true;
+        }
+        std::stack<std::shared_ptr<Environment>> &environmentStack = state().environmentStack;
+        if (environmentStack.top() != frames.back().env)
+        {
+            environmentStack.pop();
+            environmentStack.push(frames.back().env);
+        }
+        if (suspended)
+        {
+            break;
+        }
+    }
+    exitBlock();
+    return !frames.empty();
+}
+
+
+void Interpreter::visitReturnStmt(ReturnStmt *stmt)
+{
+
+    std::shared_ptr<Expr> value = evaluate(stmt->value);
+    if (!value)
+    {
+        Error("RETURN: invalid  value ");
+    }
     throw ReturnException(value);
 }
-void Interpreter::visitIfStmt(IfStmt *stmt)
+Stmt *Interpreter::selectBranch(IfStmt *stmt)
 {
     if (isTruthy(evaluate(stmt->condition)))
     {
-        execute(stmt->thenBranch);
-        return;
+        return stmt->thenBranch.get();
     }
 
     for (const auto &elif : stmt->elifBranch)
     {
         if (isTruthy(evaluate(elif->condition)))
         {
-            execute(elif->thenBranch);
-            return;
+            return elif->thenBranch.get();
         }
     }
 
-    if (stmt->elseBranch != nullptr)
+    return stmt->elseBranch.get();
+}
+
+void Interpreter::visitIfStmt(IfStmt *stmt)
+{
+    Stmt *branch = selectBranch(stmt);
+    if (branch != nullptr)
     {
-        execute(stmt->elseBranch);
+        execute(branch);
     }
 }
 
@@ -1015,26 +1669,40 @@ void Interpreter::visitWhileStmt(WhileStmt *stmt)
         Error("invalid while condition expression");
         return;
     }
-    addressLoop = getAddress(stmt);
-    while (true)
+    state().addressLoop = getAddress(stmt);
+    try
     {
-        auto result = evaluate(stmt->condition);
-
-        if (!result)
+        while (true)
         {
-            Error("invalid condition expression");
-            addressLoop = 0x0;
-            return;
-        }
+            auto result = evaluate(stmt->condition);
 
-        if (!isTruthy(result))
-        {
-            break;
-        }
+            if (!result)
+            {
+                Error("invalid condition expression");
+                state().addressLoop = 0x0;
+                return;
+            }
+
+            if (!isTruthy(result))
+            {
+                break;
+            }
 
-        execute(stmt->body);
+            try
+            {
+                execute(stmt->body);
+            }
+            catch (ContinueException &)
+            {
+                // Do nothing, just continue the loop
+            }
+        }
+    }
+    catch (BreakException &)
+    {
+        // Exit the loop
     }
-    addressLoop = 0x0;
+    state().addressLoop = 0x0;
 }
 
 void Interpreter::visitBreakStmt(BreakStmt *stmt)
@@ -1068,7 +1736,7 @@ void Interpreter::visitRepeatStmt(RepeatStmt *stmt)
     }
     try
     {
-        addressLoop = getAddress(stmt);
+        state().addressLoop = getAddress(stmt);
         do
         {
             try
@@ -1084,7 +1752,7 @@ void Interpreter::visitRepeatStmt(RepeatStmt *stmt)
             if (!result)
             {
                 Error("invalid condition expression");
-                addressLoop = 0x0;
+                state().addressLoop = 0x0;
                 return;
             }
 
@@ -1099,7 +1767,7 @@ void Interpreter::visitRepeatStmt(RepeatStmt *stmt)
     {
         // Exit the loop
     }
-    addressLoop = 0x0;
+    state().addressLoop = 0x0;
 }
 
 void Interpreter::visitLoopStmt(LoopStmt *stmt)
@@ -1112,7 +1780,7 @@ void Interpreter::visitLoopStmt(LoopStmt *stmt)
         }
         try
         {
-            addressLoop = getAddress(stmt);
+            state().addressLoop = getAddress(stmt);
             while(true)
             {
                 try
@@ -1130,32 +1798,26 @@ void Interpreter::visitLoopStmt(LoopStmt *stmt)
             // Exit the loop
             return ;
         }
-        addressLoop = 0x0;
+        state().addressLoop = 0x0;
 
 
 }
 
-void Interpreter::visitSwitchStmt(SwitchStmt *stmt)
+Stmt *Interpreter::selectCase(SwitchStmt *stmt)
 {
 
-    if (!stmt)
-    {
-        Error("invalid switch expression");
-        return;
-    }
-
     auto switch_value = evaluate(stmt->expression);
     if (!switch_value)
     {
         Error("invalid switch expression");
-        return;
+        return nullptr;
     }
 
     LiteralExpr *literal = dynamic_cast<LiteralExpr *>(switch_value.get());
     if (!literal)
     {
         Error("invalid switch expression");
-        return;
+        return nullptr;
     }
 
     for (const auto &caseStmt : stmt->cases)
@@ -1165,18 +1827,30 @@ void Interpreter::visitSwitchStmt(SwitchStmt *stmt)
         if (!result)
         {
             Error("invalid switch expression");
-            return;
+            return nullptr;
         }
         LiteralExpr *literalValue = dynamic_cast<LiteralExpr *>(result.get());
         if (Equal(literal, literalValue))
         {
-            execute(caseStmt->body);
-            return;
+            return caseStmt->body.get();
         }
     }
-    if (stmt->default_case)
+    return stmt->default_case.get();
+}
+
+void Interpreter::visitSwitchStmt(SwitchStmt *stmt)
+{
+
+    if (!stmt)
+    {
+        Error("invalid switch expression");
+        return;
+    }
+
+    Stmt *branch = selectCase(stmt);
+    if (branch != nullptr)
     {
-        execute(stmt->default_case);
+        execute(branch);
     }
 }
 
@@ -1190,7 +1864,7 @@ void Interpreter::visitForStmt(ForStmt *stmt)
 
     try
     {
-        addressLoop = getAddress(stmt);
+        state().addressLoop = getAddress(stmt);
         if (stmt->initializer)
         {
 
@@ -1205,7 +1879,7 @@ void Interpreter::visitForStmt(ForStmt *stmt)
                 if (!conditionResult)
                 {
                     Error("invalid condition expression");
-                    addressLoop = 0x0;
+                    state().addressLoop = 0x0;
                     return;
                 }
 
@@ -1237,7 +1911,7 @@ void Interpreter::visitForStmt(ForStmt *stmt)
     {
         // Exit the loop
     }
-    addressLoop = 0x0;
+    state().addressLoop = 0x0;
 }
 
 bool Interpreter::isTruthy(const std::shared_ptr<Expr> &expr)
@@ -1322,7 +1996,7 @@ bool Interpreter::isNativeFunctionDefined(const std::string &name) const
 {
     return (nativeFunctions.find(name) != nativeFunctions.end());
 }
-void Interpreter::registerFunction(const std::string &name, NativeFunction function)
+void Interpreter::registerFunction(const std::string &name, NativeFunction function, int flags)
 {
     if (functionList.find(name) != functionList.end())
     {
@@ -1331,32 +2005,42 @@ void Interpreter::registerFunction(const std::string &name, NativeFunction funct
     }
     lexer.addNative(name);
     nativeFunctions[name] = function;
+    if (flags & NATIVE_LOCAL)
+    {
+        localNatives.insert(name);
+    }
 }
 
 void Interpreter::registerGlobalScope(GlobalScope function)
 {
    
 
-    function(this->context.get());
+    function(mainState.context.get());
 
    //  this->mainEnvironment->print();
 }
 
 //*****************************************************************************************
 
-Environment::Environment(int depth,  std::shared_ptr<Environment> parent) : m_depth(depth), m_parent(parent)
+Environment::Environment(int depth,  std::shared_ptr<Environment> parent) : m_depth(depth), m_epoch(0), m_parent(parent)
 {
     // std::cout<<"Create Environment: "<< m_depth << std::endl;
+    Memory::alloc(MEMORY_INTERPRETER, sizeof(Environment));
 }
 
 Environment::~Environment()
 {
      // std::cout<<"Delete Environment()"<< m_depth<<std::endl;
+    Memory::free(MEMORY_INTERPRETER, sizeof(Environment));
 }
 
 bool Environment::define(const std::string &name, const Literal &value)
 {
    if (m_values.find(name) != m_values.end())
+    {
+        return false;
+    }
+    if (!m_builtins.empty() && processLocalSlot(name) >= 0)
     {
         return false;
     }
@@ -1364,6 +2048,12 @@ bool Environment::define(const std::string &name, const Literal &value)
     return true;
 }
 
+Literal *Environment::local(const std::string &name)
+{
+    auto it = m_values.find(name);
+    return it != m_values.end() ? &it->second : nullptr;
+}
+
 Literal* Environment::get(const std::string &name)
 {
 
@@ -1372,6 +2062,14 @@ Literal* Environment::get(const std::string &name)
     {
         return &(it->second);
     }
+    if (!m_builtins.empty())
+    {
+        int slot = processLocalSlot(name);
+        if (slot >= 0)
+        {
+            return &m_builtins[slot];
+        }
+    }
     if (m_parent != nullptr)
     {
         return m_parent->get(name);
@@ -1433,6 +2131,15 @@ bool Environment::assign(const std::string &name, const Literal &value)
         it->second.assign(value);
         return true;
     }
+    if (!m_builtins.empty())
+    {
+        int slot = processLocalSlot(name);
+        if (slot >= 0)
+        {
+            m_builtins[slot].assign(value);
+            return true;
+        }
+    }
     if (m_parent != nullptr)
     {
         return m_parent->assign(name, value);
@@ -1440,6 +2147,41 @@ bool Environment::assign(const std::string &name, const Literal &value)
     return false;
 }
 
+void Environment::mark(Heap &heap)
+{
+    if (m_epoch == heap.epoch())
+    {
+        return;
+    }
+    m_epoch = heap.epoch();
+    for (auto &it : m_values)
+    {
+        heap.shade(it.second);
+    }
+    for (auto &value : m_builtins)
+    {
+        heap.shade(value);
+    }
+    if (m_parent != nullptr)
+    {
+        m_parent->mark(heap);
+    }
+}
+
+void Environment::reset(int depth, std::shared_ptr<Environment> parent, const Environment &defaults)
+{
+    m_depth = depth;
+    m_epoch = 0;
+    m_parent = std::move(parent);
+    m_values = defaults.m_values;
+    m_builtins = defaults.m_builtins;
+}
+
+void Environment::setBuiltins(const std::vector<Literal> &values)
+{
+    m_builtins.assign(values.begin(), values.end());
+}
+
 void Environment::remove(const std::string &name)
 {
 
@@ -1459,6 +2201,10 @@ void Environment::print()
     {
         Log(0, "Variable: %s Value: %s", it->first.c_str(), it->second.toString().c_str());
     }
+    for (size_t i = 0; i < m_builtins.size(); i++)
+    {
+        Log(0, "Variable: %s Value: %s", processLocals[i].name, m_builtins[i].toString().c_str());
+    }
 }
 
 bool Environment::contains(const std::string &name)
@@ -1467,6 +2213,10 @@ bool Environment::contains(const std::string &name)
     {
         return true;
     }
+    if (!m_builtins.empty() && processLocalSlot(name) >= 0)
+    {
+        return true;
+    }
     if (m_parent != nullptr)
     {
         if (m_parent->contains(name))
@@ -1529,54 +2279,209 @@ bool Environment::addBool(const std::string &name, bool value)
 
 // //*****************************************************************************************
 
+LiteralPool::LiteralPool(const char *name, size_t maxFree)
+    : name(name), blockSize(0), maxFree(maxFree), hits(0), misses(0), live(0), highWater(0),
+      owner(std::this_thread::get_id()), orphaned(false), remotePending(false)
+{
+    freeList.reserve(maxFree);
+}
+
+LiteralPool::~LiteralPool()
+{
+    clear();
+}
+
+void *LiteralPool::acquire(size_t size)
+{
+    if (blockSize == 0)
+    {
+        blockSize = size;
+    }
+    if (size != blockSize)
+    {
+        misses++;
+        Memory::alloc(MEMORY_LITERAL, size);
+        return ::operator new(size);
+    }
+
+    size_t count = live.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (count > highWater)
+    {
+        highWater = count;
+    }
+
+    if (freeList.empty() && remotePending.load(std::memory_order_acquire))
+    {
+        std::lock_guard<std::mutex> lock(remoteLock);
+        freeList.swap(remote);
+        remotePending.store(false, std::memory_order_relaxed);
+    }
+    if (!freeList.empty())
+    {
+        hits++;
+        void *block = freeList.back();
+        freeList.pop_back();
+        return block;
+    }
+    misses++;
+    Memory::alloc(MEMORY_LITERAL, blockSize);
+    return ::operator new(blockSize);
+}
+
+void LiteralPool::dispose(void *block, size_t size)
+{
+    Memory::free(MEMORY_LITERAL, size);
+    ::operator delete(block);
+}
+
+void LiteralPool::release(void *block, size_t size)
+{
+    if (orphaned.load(std::memory_order_acquire) || std::this_thread::get_id() != owner)
+    {
+        releaseRemote(block, size);
+        return;
+    }
+    if (size != blockSize)
+    {
+        dispose(block, size);
+        return;
+    }
+    live.fetch_sub(1, std::memory_order_relaxed);
+    if (freeList.size() < maxFree)
+    {
+        freeList.push_back(block);
+        return;
+    }
+    dispose(block, size);
+}
+
+void LiteralPool::releaseRemote(void *block, size_t size)
+{
+    bool last = false;
+    {
+        std::lock_guard<std::mutex> lock(remoteLock);
+        if (size != blockSize)
+        {
+            dispose(block, size);
+            return;
+        }
+        if (!orphaned.load(std::memory_order_relaxed) && remote.size() < maxFree)
+        {
+            remote.push_back(block);
+            remotePending.store(true, std::memory_order_release);
+        }
+        else
+        {
+            dispose(block, size);
+        }
+        last = live.fetch_sub(1, std::memory_order_acq_rel) == 1 && orphaned.load(std::memory_order_relaxed);
+    }
+    if (last)
+    {
+        delete this;
+    }
+}
+
+void LiteralPool::clear()
+{
+    for (void *block : freeList)
+    {
+        dispose(block, blockSize);
+    }
+    freeList.clear();
+    std::lock_guard<std::mutex> lock(remoteLock);
+    for (void *block : remote)
+    {
+        dispose(block, blockSize);
+    }
+    remote.clear();
+    remotePending.store(false, std::memory_order_relaxed);
+}
+
+void LiteralPool::orphan()
+{
+    clear();
+    bool empty = false;
+    {
+        std::lock_guard<std::mutex> lock(remoteLock);
+        orphaned.store(true, std::memory_order_release);
+        empty = live.load(std::memory_order_acquire) == 0;
+    }
+    if (empty)
+    {
+        delete this;
+    }
+}
+
+double LiteralPool::hitRate() const
+{
+    size_t total = hits + misses;
+    if (total == 0)
+        return 0.0;
+    return (double)hits / (double)total * 100.0;
+}
+
 Factory::Factory()
+    : intPool(new LiteralPool("int", MaxPool)), floatPool(new LiteralPool("float", MaxPool)),
+      boolPool(new LiteralPool("bool", MaxPool)), stringPool(new LiteralPool("string", MaxPool)),
+      bytePool(new LiteralPool("byte", MaxPool)), objectPool(new LiteralPool("object", MaxPool)),
+      literalPool(new LiteralPool("native", MaxPool))
 {
     
 }
 
 Factory::~Factory()
 {
-
-    clear();
+    LiteralPool *pools[] = {intPool, floatPool, boolPool, stringPool, bytePool, objectPool, literalPool};
+    for (LiteralPool *pool : pools)
+    {
+        pool->orphan();
+    }
 }
 
 
+void Factory::release(std::shared_ptr<Literal> &literal)
+{
+    literal.reset();
+}
 
 std::shared_ptr<Literal> Factory::acquireInteger(long value)
 {
-    std::shared_ptr<Literal> literal = std::make_shared<Literal>( value);
-    return literal;
+    return std::allocate_shared<Literal>(PoolAllocator<Literal>(literalPool), value);
 }
 
 
 
 std::shared_ptr<Literal> Factory::acquireFloat(double value)
 {
-
-       std::shared_ptr<Literal> literal = std::make_shared<Literal>( value);
-    return literal;
+    return std::allocate_shared<Literal>(PoolAllocator<Literal>(literalPool), value);
 }
 
 
 
 std::shared_ptr<Literal> Factory::acquireByte(unsigned char value)
 {
-
-    std::shared_ptr<Literal> literal = std::make_shared<Literal>( value);
-    return literal;
+    return std::allocate_shared<Literal>(PoolAllocator<Literal>(literalPool), value);
 }
 
 std::shared_ptr<Literal> Factory::acquireBool(bool value)
 {
-    std::shared_ptr<Literal> literal = std::make_shared<Literal>( value);
-    return literal;
+    return std::allocate_shared<Literal>(PoolAllocator<Literal>(literalPool), value);
 }
 
 std::shared_ptr<Literal> Factory::acquireString(const std::string &value)
 {
+    return std::allocate_shared<Literal>(PoolAllocator<Literal>(literalPool), value);
+}
+
+std::shared_ptr<Literal> Factory::acquireObject(HeapObject *value)
+{
+    return std::allocate_shared<Literal>(PoolAllocator<Literal>(literalPool), value);
+}
 
-    std::shared_ptr<Literal> literal = std::make_shared<Literal>( value);
-    return literal;
+std::shared_ptr<Literal> Factory::acquire(const Literal &value)
+{
+    return std::allocate_shared<Literal>(PoolAllocator<Literal>(literalPool), value);
 }
 
 
@@ -1590,61 +2495,80 @@ void Factory::clear()
 
  
 
-    intPool.clear();
-    floatPool.clear();
-    bytePool.clear();
-    boolPool.clear();
-    stringPool.clear();
+    intPool->clear();
+    floatPool->clear();
+    bytePool->clear();
+    boolPool->clear();
+    stringPool->clear();
+    objectPool->clear();
+    literalPool->clear();
 
 
 }
 
+void Factory::printStats() const
+{
+    const LiteralPool *pools[] = {intPool, floatPool, boolPool, stringPool, bytePool, objectPool, literalPool};
+    for (const LiteralPool *pool : pools)
+    {
+        Log(0, "Pool %-7s hits: %zu misses: %zu (%.1f%%) live: %zu high water: %zu",
+            pool->name, pool->hits, pool->misses, pool->hitRate(), pool->live.load(), pool->highWater);
+    }
+}
+
 
 
 std::shared_ptr<LiteralExpr> Factory::createIntegerLiteral(long value)
 {
-      
-        auto expression = std::make_shared<LiteralExpr>(value);
-        return expression;
+    return std::allocate_shared<LiteralExpr>(PoolAllocator<LiteralExpr>(intPool), value);
 }
 
 std::shared_ptr<LiteralExpr> Factory::createStringLiteral(const std::string &value)
 {
-
-
-   
-        auto expression = std::make_shared<LiteralExpr>(value);
-  
-        return expression;
+    return std::allocate_shared<LiteralExpr>(PoolAllocator<LiteralExpr>(stringPool), value);
 }
 
 std::shared_ptr<LiteralExpr> Factory::createBoolLiteral(bool value)
 {
-
-      
-        auto expression = std::make_shared<LiteralExpr>(value);
-  
-        return expression;
-    
+    return std::allocate_shared<LiteralExpr>(PoolAllocator<LiteralExpr>(boolPool), value);
 }
 
 std::shared_ptr<LiteralExpr> Factory::createFloatLiteral(double value)
 {
-
-
-    
-        auto expression = std::make_shared<LiteralExpr>( value);
-        return expression;
-  
+    return std::allocate_shared<LiteralExpr>(PoolAllocator<LiteralExpr>(floatPool), value);
 }
 
 
 std::shared_ptr<LiteralExpr> Factory::createByteLiteral(unsigned char value)
 {
+    return std::allocate_shared<LiteralExpr>(PoolAllocator<LiteralExpr>(bytePool), value);
+}
 
-        auto expression = std::make_shared<LiteralExpr>( value);
-        return expression;
+std::shared_ptr<LiteralExpr> Factory::createObjectLiteral(HeapObject *value)
+{
+    return std::allocate_shared<LiteralExpr>(PoolAllocator<LiteralExpr>(objectPool), value);
+}
 
+std::shared_ptr<LiteralExpr> Factory::createLiteral(const Literal &value)
+{
+    switch (value.getType())
+    {
+    case LiteralType::INT:
+        return createIntegerLiteral(value.getInt());
+    case LiteralType::FLOAT:
+        return createFloatLiteral(value.getFloat());
+    case LiteralType::BYTE:
+        return createByteLiteral(value.getByte());
+    case LiteralType::BOOLEAN:
+        return createBoolLiteral(value.getBool());
+    case LiteralType::STRING:
+        return createStringLiteral(value.getString());
+    case LiteralType::OBJECT:
+        return createObjectLiteral(value.getObject());
+    default:
+        break;
+    }
+    return nullptr;
 }
 
 
@@ -1680,6 +2604,16 @@ LiteralPtr ExecutionContext::asString(const char *value)
     return literal;
 }
 
+LiteralPtr ExecutionContext::asObject(HeapObject *value)
+{
+    return Factory::Instance().acquireObject(value);
+}
+
+LiteralPtr ExecutionContext::asLiteral(const Literal &value)
+{
+    return Factory::Instance().acquire(value);
+}
+
 LiteralPtr ExecutionContext::asBool(bool value)
 {
 
@@ -1788,6 +2722,18 @@ double ExecutionContext::getFloat(size_t index)
     return literal->getFloat();
 }
 
+Random &ExecutionContext::random()
+{
+    return currentProcess ? currentProcess->getRandom() : interpreter->mainRandom();
+}
+
+uint64_t ExecutionContext::setRandomSeed(uint64_t seed)
+{
+    uint64_t previous = interpreter->getRandomSeed();
+    interpreter->setRandomSeed(seed);
+    return previous;
+}
+
 unsigned char ExecutionContext::getByte(size_t index)
 {
     Literal *literal = getLiteralByte(index);
@@ -1808,6 +2754,96 @@ bool ExecutionContext::getBool(size_t index)
     return literal->getBool();
 }
 
+HeapObject *ExecutionContext::getObject(size_t index)
+{
+    Literal *literal = Get(index);
+    if (!literal)
+    {
+        return nullptr;
+    }
+    return literal->getObject();
+}
+
+Literal *ExecutionContext::getLiteral(size_t index)
+{
+    return Get(index);
+}
+
+Heap *ExecutionContext::getHeap()
+{
+    return &interpreter->getHeap();
+}
+
+Process *ExecutionContext::findProcess(long id)
+{
+    return interpreter->findProcess(id);
+}
+
+size_t ExecutionContext::spawnMany(const std::string &name, size_t count, const std::vector<Literal> &arguments)
+{
+    return interpreter->spawnMany(name, count, arguments);
+}
+
+bool ExecutionContext::signal(long id, int code, const Literal &value)
+{
+    Process *process = interpreter->findProcess(id);
+    if (!process)
+    {
+        return false;
+    }
+    interpreter->signalProcess(process, code, value, currentProcess ? currentProcess->ID : 0);
+    return true;
+}
+
+size_t ExecutionContext::signalType(const std::string &name, int code)
+{
+    return interpreter->signalType(name, code, currentProcess ? currentProcess->ID : 0);
+}
+
+long ExecutionContext::typeIndex(const std::string &name)
+{
+    return interpreter->typeIndex(name);
+}
+
+Process *ExecutionContext::firstOfType(long type)
+{
+    return interpreter->firstOfType(type);
+}
+
+long ExecutionContext::nextOfType(long type)
+{
+    return interpreter->nextOfType(type, currentProcess);
+}
+
+size_t ExecutionContext::countOfType(long type)
+{
+    return interpreter->countOfType(type);
+}
+
+bool ExecutionContext::setTickRate(const std::string &name, double rate)
+{
+    return interpreter->setTickRate(name, rate);
+}
+
+double ExecutionContext::setFrameBudget(double ms)
+{
+    double previous = interpreter->getFrameBudget();
+    interpreter->setFrameBudget(ms);
+    return previous;
+}
+
+bool ExecutionContext::setDeferrable(const std::string &name, bool deferrable)
+{
+    return interpreter->setDeferrable(name, deferrable);
+}
+
+long ExecutionContext::setTickBudget(long statements, bool kill)
+{
+    long previous = interpreter->getTickBudget();
+    interpreter->setTickBudget(statements, kill);
+    return previous;
+}
+
 Process *ExecutionContext::getCurrentProcess()
 {
     if (currentProcess == nullptr)
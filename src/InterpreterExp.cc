@@ -68,6 +68,9 @@ std::shared_ptr<Expr> Interpreter::ReturnByType(LiteralExpr *expr)
         } else if (expr->value.getType() == LiteralType::BYTE)
         {
             return  Factory::Instance().createByteLiteral(expr->value.getByte());
+        } else if (expr->value.getType() == LiteralType::OBJECT)
+        {
+            return  Factory::Instance().createObjectLiteral(expr->value.getObject());
         }
       
      return  Factory::Instance().createBoolLiteral(false);    
@@ -464,6 +467,10 @@ std::shared_ptr<Expr> Interpreter::EqualEqual(LiteralExpr *leftLiteral, LiteralE
     {
         return  Factory::Instance().createBoolLiteral(leftLiteral->value.getBool() == rightLiteral->value.getBool());
     }
+    else if (leftType == LiteralType::OBJECT || rightType == LiteralType::OBJECT)
+    {
+        return  Factory::Instance().createBoolLiteral(leftLiteral->value.isEqual(rightLiteral->value));
+    }
     else if (leftType == LiteralType::STRING && rightType == LiteralType::STRING)
     {
         return  Factory::Instance().createBoolLiteral(leftLiteral->value.getString() == rightLiteral->value.getString());
@@ -747,6 +754,10 @@ std::shared_ptr<Expr> Interpreter::NotEqual(LiteralExpr *leftLiteral, LiteralExp
     {
         return  Factory::Instance().createBoolLiteral(leftLiteral->value.getBool() != rightLiteral->value.getBool());
     }
+    else if (leftType == LiteralType::OBJECT || rightType == LiteralType::OBJECT)
+    {
+        return  Factory::Instance().createBoolLiteral(!leftLiteral->value.isEqual(rightLiteral->value));
+    }
     else if (leftType == LiteralType::STRING && rightType == LiteralType::STRING)
     {
         return  Factory::Instance().createBoolLiteral(leftLiteral->value.getString() != rightLiteral->value.getString());
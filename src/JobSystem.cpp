@@ -0,0 +1,187 @@
+#include "pch.h"
+#include "JobSystem.hpp"
+#include "Utils.hpp"
+
+JobSystem::JobSystem() : job(nullptr), generation(0), busy(0), quit(false), pending(0), steals(0)
+{
+}
+
+JobSystem::~JobSystem()
+{
+    stop();
+}
+
+void JobSystem::start(size_t count)
+{
+    stop();
+    if (count <= 1)
+    {
+        return;
+    }
+    quit = false;
+    for (size_t i = 0; i < count; i++)
+    {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (size_t i = 1; i < count; i++)
+    {
+        threads.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+    Log(0, "Job system started with %zu workers", count);
+}
+
+void JobSystem::stop()
+{
+    if (threads.empty())
+    {
+        queues.clear();
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(wakeLock);
+        quit = true;
+    }
+    wake.notify_all();
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    threads.clear();
+    queues.clear();
+}
+
+bool JobSystem::pop(size_t worker, Range &range)
+{
+    Queue &queue = *queues[worker];
+    std::lock_guard<std::mutex> lock(queue.lock);
+    if (queue.ranges.empty())
+    {
+        return false;
+    }
+    range = queue.ranges.back();
+    queue.ranges.pop_back();
+    return true;
+}
+
+bool JobSystem::steal(size_t worker, Range &range)
+{
+    for (size_t i = 1; i < queues.size(); i++)
+    {
+        Queue &queue = *queues[(worker + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.lock);
+        if (queue.ranges.empty())
+        {
+            continue;
+        }
+        range = queue.ranges.front();
+        queue.ranges.pop_front();
+        steals.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+void JobSystem::runRanges(size_t worker, const RangeJob &job)
+{
+    Range range;
+    while (pop(worker, range) || steal(worker, range))
+    {
+        try
+        {
+            job(range.begin, range.end, worker);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(failureLock);
+            if (!failure)
+            {
+                failure = std::current_exception();
+            }
+        }
+        if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            std::lock_guard<std::mutex> lock(wakeLock);
+            done.notify_all();
+        }
+    }
+}
+
+void JobSystem::workerLoop(size_t worker)
+{
+    size_t seen = 0;
+    while (true)
+    {
+        const RangeJob *current = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(wakeLock);
+            wake.wait(lock, [&] { return quit || generation != seen; });
+            if (quit)
+            {
+                return;
+            }
+            seen = generation;
+            current = job;
+            if (current)
+            {
+                busy++;
+            }
+        }
+        if (!current)
+        {
+            continue;
+        }
+        runRanges(worker, *current);
+        {
+            std::lock_guard<std::mutex> lock(wakeLock);
+            busy--;
+        }
+        done.notify_all();
+    }
+}
+
+void JobSystem::parallelFor(size_t count, size_t grain, const RangeJob &job)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    if (grain == 0)
+    {
+        grain = 1;
+    }
+    if (threads.empty() || count <= grain)
+    {
+        job(0, count, 0);
+        return;
+    }
+
+    size_t chunks = 0;
+    for (size_t begin = 0; begin < count; begin += grain)
+    {
+        Queue &queue = *queues[chunks % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.lock);
+        queue.ranges.push_back({begin, std::min(begin + grain, count)});
+        chunks++;
+    }
+    pending.store(chunks, std::memory_order_release);
+    failure = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(wakeLock);
+        this->job = &job;
+        generation++;
+    }
+    wake.notify_all();
+
+    runRanges(0, job);
+
+    {
+        std::unique_lock<std::mutex> lock(wakeLock);
+        done.wait(lock, [&] { return pending.load(std::memory_order_acquire) == 0 && busy == 0; });
+        this->job = nullptr;
+    }
+
+    if (failure)
+    {
+        std::rethrow_exception(failure);
+    }
+}
@@ -416,6 +416,7 @@ void Lexer::initialize()
 
     keywords["break"] = TokenType::BREAK;
     keywords["continue"] = TokenType::CONTINUE;
+    keywords["frame"] = TokenType::FRAME;
     keywords["return"] = TokenType::RETURN;
 
     keywords["function"] = TokenType::FUNCTION;
@@ -429,6 +430,7 @@ void Lexer::initialize()
     keywords["float"] = TokenType::IDFLOAT;
     keywords["byte"] = TokenType::IDBYTE;
     keywords["string"] = TokenType::IDSTRING;
+    keywords["var"] = TokenType::IDVAR;
     keywords["bool"] = TokenType::IDBOOL;
     keywords["false"] = TokenType::FALSE;
     keywords["true"] = TokenType::TRUE;
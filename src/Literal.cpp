@@ -1,6 +1,7 @@
 #include "pch.h"
 #include "Literal.hpp"
 #include "Interpreter.hpp"
+#include "Heap.hpp"
 #include "Utils.hpp"
 
 
@@ -138,6 +139,12 @@ Literal::Literal(const std::string &v)
     value = v;
 }
 
+Literal::Literal(HeapObject *v)
+{
+    type = OBJECT;
+    value = v;
+}
+
 Literal::~Literal()
 {
    // Log(0, "Literal deleted %s", toString().c_str());
@@ -207,122 +214,179 @@ long Literal::getInt() const
     return INT32_MAX;
 }
 
-void Literal::setString(const std::string &v)
+HeapObject *Literal::getObject() const
 {
-    if (type == STRING)
-        value = v;
-    else
+    if (type == OBJECT)
+        return std::get<HeapObject *>(value);
+    return nullptr;
+}
+
+void Literal::setObject(HeapObject *v)
+{
+    type = OBJECT;
+    value = v;
+}
+
+static const char *type_name(LiteralType type)
+{
+    switch (type)
     {
-        if (type == INT)
-            value = static_cast<long>(std::stol(v)); 
-        else if (type == FLOAT)
-            value = static_cast<double>(std::stold(v));
-        else if (type == BYTE)
-            value =  static_cast<unsigned char>(std::stoul(v));
-        else if (type == BOOLEAN)
-            value = static_cast<bool>(std::stoi(v));
-         else
-         {
-                type = STRING;
-                value = v;
-         }   
+    case STRING:
+        return "string";
+    case INT:
+        return "int";
+    case FLOAT:
+        return "float";
+    case BYTE:
+        return "byte";
+    case BOOLEAN:
+        return "bool";
+    case OBJECT:
+        return "var";
+    default:
+        break;
     }
+    return "undefined";
+}
 
-  
+Literal Literal::slot(LiteralType type)
+{
+    switch (type)
+    {
+    case STRING:
+        return Literal(std::string());
+    case INT:
+        return Literal(0L);
+    case FLOAT:
+        return Literal(0.0);
+    case BYTE:
+        return Literal((unsigned char)0);
+    case BOOLEAN:
+        return Literal(false);
+    case OBJECT:
+        return Literal((HeapObject *)nullptr);
+    default:
+        break;
+    }
+    return Literal();
+}
+
+// Setters store into the slot's declared type. Numeric slots cast, an
+// undefined slot takes the type of the value, anything else is refused.
 
+void Literal::setString(const std::string &v)
+{
+    if (type == STRING || type == UNDEFINED)
+    {
+        type = STRING;
+        value = v;
+        return;
+    }
+    Log(2, "Literal::setString: cannot store string in %s slot", type_name(type));
 }
 
 void Literal::setFloat( double v)
 {
-    if (type == FLOAT)
-        value = v;
-    else
+    switch (type)
     {
-        if (type == INT)
-            value = static_cast<double>(v);
-        else if (type == BOOLEAN)
-            value = static_cast<bool>(v);
-       else  if (type == BYTE)
-            value =  static_cast<unsigned char>(v);
-        else if (type == STRING)
-            value = std::to_string(v);
-        {
-            type = FLOAT;
-            value = v;
-        }
-            
+    case FLOAT:
+        value = v;
+        break;
+    case INT:
+        value = static_cast<long>(v);
+        break;
+    case BYTE:
+        value = static_cast<unsigned char>(v);
+        break;
+    case BOOLEAN:
+        value = v != 0.0;
+        break;
+    case UNDEFINED:
+        type = FLOAT;
+        value = v;
+        break;
+    default:
+        Log(2, "Literal::setFloat: cannot store float in %s slot", type_name(type));
+        break;
     }
-
-
 }
 
 void Literal::setBool( bool v)
 {
-    if (type == BOOLEAN)
-        value = v;
-    else
+    switch (type)
     {
-        if (type == INT)
-            value = static_cast<long>(v);
-        else if (type == FLOAT)
-            value = static_cast<double>(v);
-        else if (type == BYTE)
-            value =  static_cast<unsigned char>(v);
-        else if (type == STRING)
-            value = std::to_string(v);
-        else 
-        {
-            type = BOOLEAN;
-            value = v;
-        }
+    case BOOLEAN:
+        value = v;
+        break;
+    case INT:
+        value = static_cast<long>(v);
+        break;
+    case FLOAT:
+        value = static_cast<double>(v);
+        break;
+    case BYTE:
+        value = static_cast<unsigned char>(v);
+        break;
+    case UNDEFINED:
+        type = BOOLEAN;
+        value = v;
+        break;
+    default:
+        Log(2, "Literal::setBool: cannot store bool in %s slot", type_name(type));
+        break;
     }
-
 }
 
 void Literal::setByte( unsigned char v)
 {
-    if (type == BYTE)
-        value = v;
-    else
+    switch (type)
     {
-        if (type == INT)
-            value = static_cast<long>(v);
-        else if (type == FLOAT)
-            value = static_cast<double>(v);
-        else if (type == BOOLEAN)
-            value = static_cast<bool>(v);
-        else if (type == STRING)
-            value = std::to_string(v);
-        else
-        {
-            type = BYTE;
-            value = v;
-        }
+    case BYTE:
+        value = v;
+        break;
+    case INT:
+        value = static_cast<long>(v);
+        break;
+    case FLOAT:
+        value = static_cast<double>(v);
+        break;
+    case BOOLEAN:
+        value = v != 0;
+        break;
+    case UNDEFINED:
+        type = BYTE;
+        value = v;
+        break;
+    default:
+        Log(2, "Literal::setByte: cannot store byte in %s slot", type_name(type));
+        break;
     }
-
 }
 
 void Literal::setInt( long v)
 {
-    if (type == INT)
-        value = v;
-    else
+    switch (type)
     {
-        if (type == FLOAT)
-            value = static_cast<double>(v);
-        else if (type == BOOLEAN)
-            value = static_cast<bool>(v);
-        else if (type == BYTE)
-            value =  static_cast<unsigned char>(v);
-        else if (type == STRING)
-            value = std::to_string(v);
-        else 
-        {
-            type = INT;
-            value = v;
-        }
+    case INT:
+        value = v;
+        break;
+    case FLOAT:
+        value = static_cast<double>(v);
+        break;
+    case BYTE:
+        value = static_cast<unsigned char>(v);
+        break;
+    case BOOLEAN:
+        value = v != 0;
+        break;
+    case UNDEFINED:
+        type = INT;
+        value = v;
+        break;
+    default:
+        Log(2, "Literal::setInt: cannot store int in %s slot", type_name(type));
+        break;
     }
-  
 }
 
 bool Literal::isTruthy() const
@@ -337,6 +401,8 @@ bool Literal::isTruthy() const
         return std::get<unsigned char>(value) != 0;
     if (type == STRING)
         return std::get<std::string>(value) != "";
+    if (type == OBJECT)
+        return std::get<HeapObject *>(value) != nullptr;
     return false;
 }
 
@@ -354,8 +420,15 @@ bool Literal::isEqual(const Literal &other) const
             return std::get<bool>(value) == std::get<bool>(other.value);
         if (type == STRING)
             return std::get<std::string>(value) == std::get<std::string>(other.value);
+        if (type == OBJECT)
+            return std::get<HeapObject *>(value) == std::get<HeapObject *>(other.value);
     } else 
     {
+        // nil is the int 0
+        if (type == OBJECT && other.type == INT)
+            return std::get<HeapObject *>(value) == nullptr && std::get<long>(other.value) == 0;
+        if (type == INT && other.type == OBJECT)
+            return std::get<HeapObject *>(other.value) == nullptr && std::get<long>(value) == 0;
         if (type == INT && other.type == FLOAT)
             return static_cast<double>(std::get<long>(value)) == std::get<double>(other.value);
         if (type == FLOAT && other.type == INT)
@@ -405,100 +478,76 @@ double Literal::asFloat() const
     return 0.0;
 }
 
-bool Literal::assign(const Literal &other)
+bool Literal::convertible(LiteralType from, LiteralType to)
 {
+    if (from == to || to == UNDEFINED)
+        return true;
+    bool numericFrom = from == INT || from == FLOAT || from == BYTE || from == BOOLEAN;
+    bool numericTo = to == INT || to == FLOAT || to == BYTE || to == BOOLEAN;
+    return numericFrom && numericTo;
+}
 
-
+// Dynamic store, used when the parser could not tie the value to the slot
+// type. Typed slots keep their type, nil (int 0) clears a var slot.
+bool Literal::assign(const Literal &other)
+{
     auto otherType = other.getType();
 
-    // Handle assignment between the same types
     if (type == otherType)
     {
         value = other.value;
         return true;
     }
 
-    // Handle conversions between different types
-    if (type == INT)
-    {
-        if (otherType == FLOAT)
-        {
-            value = static_cast<long>(other.getFloat());
-            return true;
-        }
-        if (otherType == BYTE)
-        {
-            value = static_cast<long>(other.getByte());
-            return true;
-        }
-        if (otherType == BOOLEAN)
-        {
-            value = static_cast<long>(other.getBool());
-            return true;
-        }
-    }
-    else if (type == FLOAT)
+    switch (otherType)
     {
-        if (otherType == INT)
+    case INT:
+        if (type == OBJECT && std::get<long>(other.value) == 0)
         {
-            value =  static_cast<double>(other.getInt());
+            value = static_cast<HeapObject *>(nullptr);
             return true;
         }
-        if (otherType == BYTE)
+        if (convertible(INT, type))
         {
-            value = static_cast<double>(other.getByte());
+            setInt(std::get<long>(other.value));
             return true;
         }
-        if (otherType == BOOLEAN)
+        break;
+    case FLOAT:
+        if (convertible(FLOAT, type))
         {
-            value = static_cast<double>(other.getBool());
+            setFloat(std::get<double>(other.value));
             return true;
         }
-    }
-    else if (type == BYTE)
-    {
-        if (otherType == INT)
+        break;
+    case BYTE:
+        if (convertible(BYTE, type))
         {
-            value = static_cast<unsigned char>(other.getInt());
+            setByte(std::get<unsigned char>(other.value));
             return true;
         }
-        if (otherType == FLOAT)
+        break;
+    case BOOLEAN:
+        if (convertible(BOOLEAN, type))
         {
-            value = static_cast<unsigned char>(other.getFloat());
+            setBool(std::get<bool>(other.value));
             return true;
         }
-        if (otherType == BOOLEAN)
+        break;
+    default:
+        if (type == UNDEFINED)
         {
-            value = static_cast<unsigned char>(other.getBool());
-            return true;
-        }
-    }
-    else if (type == BOOLEAN)
-    {
-        if (otherType == INT)
-        {
-            value = static_cast<bool>(other.getInt());
-            return true;
-        }
-        if (otherType == FLOAT)
-        {
-            value = static_cast<bool>(other.getFloat());
-            return true;
-        }
-        if (otherType == BYTE)
-        {
-            value = static_cast<bool>(other.getByte());
+            type = otherType;
+            value = other.value;
             return true;
         }
+        break;
     }
 
-    Log(2, "Literal::assign: unsupported type conversion");
+    Log(2, "Literal::assign: cannot store %s in %s slot", type_name(otherType), type_name(type));
     return false;
 }
 
-
-
-
 bool Literal::assign(Literal *other)
 {
     if (!other)
@@ -506,92 +555,7 @@ bool Literal::assign(Literal *other)
         Log(2, "Literal::assign: other is null");
         return false;
     }
-
-    auto otherType = other->getType();
-
-    // Handle assignment between the same types
-    if (type == otherType)
-    {
-        value = other->value;
-        return true;
-    }
-
-    // Handle conversions between different types
-    if (type == INT)
-    {
-        if (otherType == FLOAT)
-        {
-            value = static_cast<long>(other->getFloat());
-            return true;
-        }
-        if (otherType == BYTE)
-        {
-            value = static_cast<long>(other->getByte());
-            return true;
-        }
-        if (otherType == BOOLEAN)
-        {
-            value = static_cast<long>(other->getBool());
-            return true;
-        }
-    }
-    else if (type == FLOAT)
-    {
-        if (otherType == INT)
-        {
-            value = static_cast<double>(other->getInt());
-            return true;
-        }
-        if (otherType == BYTE)
-        {
-            value = static_cast<double>(other->getByte());
-            return true;
-        }
-        if (otherType == BOOLEAN)
-        {
-            value = static_cast<double>(other->getBool());
-            return true;
-        }
-    }
-    else if (type == BYTE)
-    {
-        if (otherType == INT)
-        {
-            value = static_cast<unsigned char>(other->getInt());
-            return true;
-        }
-        if (otherType == FLOAT)
-        {
-            value = static_cast<unsigned char>(other->getFloat());
-            return true;
-        }
-        if (otherType == BOOLEAN)
-        {
-            value = static_cast<unsigned char>(other->getBool());
-            return true;
-        }
-    }
-    else if (type == BOOLEAN)
-    {
-        if (otherType == INT)
-        {
-            value = static_cast<bool>(other->getInt());
-            return true;
-        }
-        if (otherType == FLOAT)
-        {
-            value = static_cast<bool>(other->getFloat());
-            return true;
-        }
-        if (otherType == BYTE)
-        {
-            value = static_cast<bool>(other->getByte());
-            return true;
-        }
-    }
-
-    Log(2, "Literal::assign: unsupported type conversion ");
-    return false;
+    return assign(*other);
 }
 
     
@@ -609,6 +573,8 @@ void Literal::print()
         Log(3, "%s", std::get<bool>(value) ? "true" : "false");
     if (type == STRING)
         Log(3, "%s", std::get<std::string>(value).c_str());
+    if (type == OBJECT)
+        Log(3, "%s", asString().c_str());
 
 }
 
@@ -650,6 +616,11 @@ std::string Literal::asString() const
         return std::to_string(std::get<unsigned char>(value));
     if (type == BOOLEAN)
         return std::to_string(std::get<bool>(value));
+    if (type == OBJECT)
+    {
+        HeapObject *object = std::get<HeapObject *>(value);
+        return object ? object->toString() : "nil";
+    }
     return "null";
 }
 
@@ -666,5 +637,7 @@ std::string Literal::toString() const
         return "BOOLEAN: "+std::to_string(std::get<bool>(value));
     if (type == STRING)
         return "STRING: "+std::get<std::string>(value);
+    if (type == OBJECT)
+        return "OBJECT: "+asString();
     return "LITERAL UNKNOWN";  
 }
@@ -0,0 +1,68 @@
+#include "pch.h"
+#include "Mailbox.hpp"
+
+Mailbox::Mailbox() : head(&stub), tail(&stub)
+{
+    stub.next.store(nullptr, std::memory_order_relaxed);
+}
+
+Mailbox::~Mailbox()
+{
+    clear();
+}
+
+void Mailbox::push(Node *node)
+{
+    node->next.store(nullptr, std::memory_order_relaxed);
+    Node *previous = head.exchange(node, std::memory_order_acq_rel);
+    previous->next.store(node, std::memory_order_release);
+}
+
+void Mailbox::post(const Message &message)
+{
+    Node *node = new Node;
+    node->message = message;
+    push(node);
+}
+
+bool Mailbox::take(Message &message)
+{
+    Node *node = tail;
+    Node *next = node->next.load(std::memory_order_acquire);
+    if (node == &stub)
+    {
+        if (!next)
+        {
+            return false;
+        }
+        tail = next;
+        node = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+    if (!next)
+    {
+        if (node != head.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        // node is the last one, the stub goes behind it so it can be unlinked
+        push(&stub);
+        next = node->next.load(std::memory_order_acquire);
+        if (!next)
+        {
+            return false;
+        }
+    }
+    tail = next;
+    message = node->message;
+    delete node;
+    return true;
+}
+
+void Mailbox::clear()
+{
+    Message message;
+    while (take(message))
+    {
+    }
+}
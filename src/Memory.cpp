@@ -0,0 +1,114 @@
+#include "pch.h"
+#include "Memory.hpp"
+#include "Utils.hpp"
+#include <atomic>
+
+struct MemoryCounter
+{
+    std::atomic<size_t> current{0};
+    std::atomic<size_t> peak{0};
+    std::atomic<size_t> allocations{0};
+    std::atomic<size_t> frees{0};
+    std::atomic<size_t> frameAllocations{0};
+    std::atomic<size_t> frameBytes{0};
+    // batch interpreters close their frames on their own threads
+    std::atomic<size_t> lastFrameAllocations{0};
+    std::atomic<size_t> lastFrameBytes{0};
+};
+
+static MemoryCounter counters[MEMORY_TAGS];
+static MemoryCounter total;
+
+static const char *tagNames[MEMORY_TAGS] = {
+    "interpreter",
+    "ast",
+    "literal",
+    "heap",
+    "scene",
+    "texture",
+};
+
+static void charge(MemoryCounter &counter, size_t bytes)
+{
+    size_t now = counter.current.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    size_t peak = counter.peak.load(std::memory_order_relaxed);
+    while (now > peak && !counter.peak.compare_exchange_weak(peak, now, std::memory_order_relaxed))
+    {
+    }
+    counter.allocations.fetch_add(1, std::memory_order_relaxed);
+    counter.frameAllocations.fetch_add(1, std::memory_order_relaxed);
+    counter.frameBytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void Memory::alloc(MemoryTag tag, size_t bytes)
+{
+    charge(counters[tag], bytes);
+    charge(total, bytes);
+}
+
+void Memory::free(MemoryTag tag, size_t bytes)
+{
+    MemoryCounter &counter = counters[tag];
+    counter.current.fetch_sub(bytes, std::memory_order_relaxed);
+    counter.frees.fetch_add(1, std::memory_order_relaxed);
+    total.current.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+MemoryStats Memory::stats(MemoryTag tag)
+{
+    const MemoryCounter &counter = counters[tag];
+    MemoryStats stats;
+    stats.current = counter.current.load(std::memory_order_relaxed);
+    stats.peak = counter.peak.load(std::memory_order_relaxed);
+    stats.allocations = counter.allocations.load(std::memory_order_relaxed);
+    stats.frees = counter.frees.load(std::memory_order_relaxed);
+    stats.frameAllocations = counter.lastFrameAllocations.load(std::memory_order_relaxed);
+    stats.frameBytes = counter.lastFrameBytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+size_t Memory::current()
+{
+    return total.current.load(std::memory_order_relaxed);
+}
+
+size_t Memory::peak()
+{
+    return total.peak.load(std::memory_order_relaxed);
+}
+
+void Memory::nextFrame()
+{
+    for (int i = 0; i < MEMORY_TAGS; i++)
+    {
+        counters[i].lastFrameAllocations.store(counters[i].frameAllocations.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+        counters[i].lastFrameBytes.store(counters[i].frameBytes.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+}
+
+const char *Memory::tagName(MemoryTag tag)
+{
+    return tagNames[tag];
+}
+
+int Memory::findTag(const std::string &name)
+{
+    for (int i = 0; i < MEMORY_TAGS; i++)
+    {
+        if (name == tagNames[i])
+            return i;
+    }
+    return -1;
+}
+
+void Memory::printStats()
+{
+    for (int i = 0; i < MEMORY_TAGS; i++)
+    {
+        MemoryStats stats = Memory::stats((MemoryTag)i);
+        Log(0, "Memory %-11s current: %8.1f KB peak: %8.1f KB allocs: %zu frees: %zu last frame: %zu (%zu bytes)",
+            tagNames[i], stats.current / 1024.0, stats.peak / 1024.0, stats.allocations, stats.frees,
+            stats.frameAllocations, stats.frameBytes);
+    }
+    Log(0, "Memory total       current: %8.1f KB peak: %8.1f KB", current() / 1024.0, peak() / 1024.0);
+}
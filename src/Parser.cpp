@@ -4,7 +4,7 @@
 #include "Interpreter.hpp"
 #include "Utils.hpp"
 
-Parser::Parser(){}
+Parser::Parser() : statementID(0) {}
 
     
 void Parser::Load(const std::vector<Token> &tokens)
@@ -14,6 +14,9 @@ current = 0;
 panicMode = false;
 countBegins = 0;
 countEnds = 0;
+arena = std::make_shared<Arena>();
+scopes.clear();
+statementID = 0;
 }
 
 Parser::~Parser()
@@ -53,6 +56,111 @@ void Parser::clear()
     panicMode = false;
     countBegins = 0;
     countEnds = 0;
+    arena = nullptr;
+    scopes.clear();
+    statementID = 0;
+    fieldIds.clear();
+    processes.clear();
+}
+
+const ProcessLocal processLocals[] = {
+    {"id", LiteralType::INT, 0},
+    {"graph", LiteralType::INT, 0},
+    {"layer", LiteralType::INT, 0},
+    {"x", LiteralType::FLOAT, 0},
+    {"y", LiteralType::FLOAT, 0},
+    {"angle", LiteralType::FLOAT, 0},
+    {"scale_x", LiteralType::FLOAT, 1},
+    {"scale_y", LiteralType::FLOAT, 1},
+    {"skew_x", LiteralType::FLOAT, 0},
+    {"skew_y", LiteralType::FLOAT, 0},
+    {"red", LiteralType::BYTE, 255},
+    {"green", LiteralType::BYTE, 255},
+    {"blue", LiteralType::BYTE, 255},
+    {"alpha", LiteralType::BYTE, 255},
+    {"show_box", LiteralType::BOOLEAN, 0},
+    {"show_pivot", LiteralType::BOOLEAN, 0},
+    {"active", LiteralType::BOOLEAN, 1},
+    {"visible", LiteralType::BOOLEAN, 1},
+    {"father", LiteralType::INT, 0},
+    {"son", LiteralType::INT, 0},
+    {"bigbro", LiteralType::INT, 0},
+    {"smallbro", LiteralType::INT, 0},
+    {"tick_rate", LiteralType::FLOAT, 0},
+    {NULL, LiteralType::UNDEFINED, 0}};
+
+int processLocalSlot(const std::string &name)
+{
+    static const std::unordered_map<std::string, int> slots = []
+    {
+        std::unordered_map<std::string, int> table;
+        for (int i = 0; processLocals[i].name != NULL; i++)
+        {
+            table[processLocals[i].name] = i;
+        }
+        return table;
+    }();
+    auto it = slots.find(name);
+    return it != slots.end() ? it->second : -1;
+}
+
+void Parser::beginScope()
+{
+    scopes.emplace_back();
+}
+
+void Parser::endScope()
+{
+    if (!scopes.empty())
+        scopes.pop_back();
+}
+
+void Parser::declare(const std::string &name, LiteralType type)
+{
+    if (scopes.empty())
+        return;
+    scopes.back()[name] = type;
+}
+
+void Parser::declare(const std::vector<std::shared_ptr<Argument>> &parameter)
+{
+    for (const auto &arg : parameter)
+    {
+        declare(arg->name, arg->expression->value.getType());
+    }
+}
+
+LiteralType Parser::resolve(const std::string &name)
+{
+    for (auto it = scopes.rbegin(); it != scopes.rend(); ++it)
+    {
+        auto found = it->find(name);
+        if (found != it->end())
+            return found->second;
+    }
+    return LiteralType::UNDEFINED;
+}
+
+// Constants stored into a declared slot are converted here, so at run time
+// the value already has the slot type and is copied without conversion.
+std::shared_ptr<Expr> Parser::fold(std::shared_ptr<Expr> value, LiteralType type, const Token &name)
+{
+    if (type == LiteralType::UNDEFINED || value->getType() != ExprType::LITERAL)
+        return value;
+    LiteralExpr *literal = static_cast<LiteralExpr *>(value.get());
+    LiteralType from = literal->value.getType();
+    if (from == type)
+        return value;
+    if (type == LiteralType::OBJECT && from == LiteralType::INT && literal->value.getInt() == 0)
+        return create<LiteralExpr>((HeapObject *)nullptr);
+    if (!Literal::convertible(from, type))
+    {
+        Warning(name, "Cannot convert constant to the type of '" + name.lexeme + "'");
+        return value;
+    }
+    Literal slot = Literal::slot(type);
+    slot.assign(literal->value);
+    return create<LiteralExpr>(slot);
 }
 
 bool Parser::match(std::vector<TokenType> types)
@@ -171,12 +279,16 @@ std::shared_ptr<Expr> Parser::assignment()
 
     // std::cout<<"Assign: "<< expr->toString()<<" type: "<<peek().toString() << std::endl;
     Token name = previous();
+    if (expr->getType() == ExprType::FIELD)
+    {
+        return fieldAssignment(std::static_pointer_cast<FieldExpr>(expr));
+    }
     if (match(TokenType::EQUAL))
     {
          std::shared_ptr<Expr> value = assignment();
          if (expr->getType() == ExprType::VARIABLE)
          {
-            return  std::make_shared<AssignExpr>(name, value);
+            return  create<AssignExpr>(name, fold(value, resolve(name.lexeme), name));
          }
 
     } else 
@@ -186,8 +298,8 @@ std::shared_ptr<Expr> Parser::assignment()
          if (expr->getType() == ExprType::VARIABLE)
          {
             Token token = Token(TokenType::PLUS_EQUAL, name.lexeme,name.literal, name.line);
-            std::shared_ptr<Expr> addition = std::make_shared<BinaryExpr>(expr, value, token);
-            return std::make_shared<AssignExpr>(name, addition);
+            std::shared_ptr<Expr> addition = create<BinaryExpr>(expr, value, token);
+            return create<AssignExpr>(name, addition);
          }
 
     } else if (match(TokenType::MINUS_EQUAL))
@@ -196,8 +308,8 @@ std::shared_ptr<Expr> Parser::assignment()
          if (expr->getType() == ExprType::VARIABLE)
          {
             Token token = Token(TokenType::MINUS_EQUAL, name.lexeme,name.literal, name.line);
-            std::shared_ptr<Expr> addition = std::make_shared<BinaryExpr>(expr, value, token);
-            return std::make_shared<AssignExpr>(name, addition);
+            std::shared_ptr<Expr> addition = create<BinaryExpr>(expr, value, token);
+            return create<AssignExpr>(name, addition);
             
          }
 
@@ -207,8 +319,8 @@ std::shared_ptr<Expr> Parser::assignment()
          if (expr->getType() == ExprType::VARIABLE)
          {
             Token token = Token(TokenType::STAR_EQUAL, name.lexeme,name.literal, name.line);
-            std::shared_ptr<Expr> addition = std::make_shared<BinaryExpr>(expr, value, token);
-            return std::make_shared<AssignExpr>(name, addition);
+            std::shared_ptr<Expr> addition = create<BinaryExpr>(expr, value, token);
+            return create<AssignExpr>(name, addition);
            
          }
 
@@ -219,8 +331,8 @@ std::shared_ptr<Expr> Parser::assignment()
          {
 
             Token token = Token(TokenType::SLASH_EQUAL, name.lexeme,name.literal, name.line);
-            std::shared_ptr<Expr> addition = std::make_shared<BinaryExpr>(expr, value, token);
-            return std::make_shared<AssignExpr>(name, addition); 
+            std::shared_ptr<Expr> addition = create<BinaryExpr>(expr, value, token);
+            return create<AssignExpr>(name, addition); 
            
          }
 
@@ -229,6 +341,22 @@ std::shared_ptr<Expr> Parser::assignment()
 }
 
 
+std::shared_ptr<Expr> Parser::fieldAssignment(std::shared_ptr<FieldExpr> field)
+{
+    LiteralType type = field->slot >= 0 ? processLocals[field->slot].type : LiteralType::UNDEFINED;
+    if (match(TokenType::EQUAL))
+    {
+        return create<FieldAssignExpr>(field, fold(assignment(), type, field->name));
+    }
+    if (match({TokenType::PLUS_EQUAL, TokenType::MINUS_EQUAL, TokenType::STAR_EQUAL, TokenType::SLASH_EQUAL}))
+    {
+        Token token = Token(previous().type, field->name.lexeme, field->name.literal, field->name.line);
+        std::shared_ptr<Expr> value = assignment();
+        return create<FieldAssignExpr>(field, create<BinaryExpr>(field, value, token));
+    }
+    return field;
+}
+
 std::shared_ptr<Expr> Parser::logic_or()
 {
     std::shared_ptr<Expr> expr = logic_and();
@@ -237,7 +365,7 @@ std::shared_ptr<Expr> Parser::logic_or()
     {
         Token op = previous();
         std::shared_ptr<Expr> right = logic_and();
-        expr = std::make_shared<LogicalExpr>(expr, right, op);
+        expr = create<LogicalExpr>(expr, right, op);
     }
     return expr;
 }
@@ -250,7 +378,7 @@ std::shared_ptr<Expr> Parser::logic_and()
     {
         Token op = previous();
         std::shared_ptr<Expr> right = logic_xor();
-        expr = std::make_shared<LogicalExpr>(expr, right, op);
+        expr = create<LogicalExpr>(expr, right, op);
     }
     return expr;
 }
@@ -263,7 +391,7 @@ std::shared_ptr<Expr> Parser::logic_xor()
     {
         Token op = previous();
         std::shared_ptr<Expr> right = equality();
-        expr = std::make_shared<LogicalExpr>(expr, right, op);
+        expr = create<LogicalExpr>(expr, right, op);
     }
     return expr;
 }
@@ -276,7 +404,7 @@ std::shared_ptr<Expr> Parser::equality()
     {
         Token op = previous();
         std::shared_ptr<Expr> right = comparison();
-        expr = std::make_shared<BinaryExpr>(expr, right, op);
+        expr = create<BinaryExpr>(expr, right, op);
     }
     return expr;
 }
@@ -288,7 +416,7 @@ std::shared_ptr<Expr> Parser::comparison()
     {
         Token op = previous();
         std::shared_ptr<Expr> right = term();
-        expr = std::make_shared<BinaryExpr>(expr, right, op);
+        expr = create<BinaryExpr>(expr, right, op);
     }
     return expr;
 }
@@ -302,7 +430,7 @@ std::shared_ptr<Expr> Parser::term()
     {
         Token op = previous();
         std::shared_ptr<Expr> right = factor();
-        expr = std::make_shared<BinaryExpr>(expr, right, op);
+        expr = create<BinaryExpr>(expr, right, op);
     }
     return expr;
 }
@@ -314,7 +442,7 @@ std::shared_ptr<Expr> Parser::factor()
     {
         Token op = previous();
         std::shared_ptr<Expr> right = power();//^
-        expr = std::make_shared<BinaryExpr>(expr, right, op);
+        expr = create<BinaryExpr>(expr, right, op);
     }
     return expr;
 }
@@ -328,7 +456,7 @@ std::shared_ptr<Expr> Parser::power()
         std::shared_ptr<Expr> right = unary();
         
    
-        expr = std::make_shared<BinaryExpr>(expr, right, op);
+        expr = create<BinaryExpr>(expr, right, op);
     }
     return expr;
 }
@@ -340,7 +468,7 @@ std::shared_ptr<Expr> Parser::unary()
         Token op = previous();
         std::shared_ptr<Expr> right = unary();
         bool isPrefix = (op.type == TokenType::INC || op.type == TokenType::DEC);
-        return std::make_shared<UnaryExpr>(right, op, isPrefix);
+        return create<UnaryExpr>(right, op, isPrefix);
     }
     return call();
 }
@@ -353,19 +481,23 @@ std::shared_ptr<Expr> Parser::call()
     {
         if (match(TokenType::IDFUNCTION))
         {
-            return functionCall();
+            expr = functionCall();
         } else 
         if (match(TokenType::IDPROCESS))       
         {
-            return processCall();
+            expr = processCall();
         }  else    if (match(TokenType::IDNATIVE))
         {
-            return   nativeFunctionCall();
-        }
-        else
-        {
-            break;
+            expr = nativeFunctionCall();
         }
+        break;
+    }
+    // id.x, father.x: the built-ins get their slot here
+    while (match(TokenType::DOT))
+    {
+        Token field = consume(TokenType::IDENTIFIER, "Expect field name after '.'.");
+        int slot = processLocalSlot(field.lexeme);
+        expr = create<FieldExpr>(expr, field, slot, slot < 0 ? fieldId(field.lexeme) : -1);
     }
     return expr;
 }
@@ -375,7 +507,7 @@ std::shared_ptr<Expr> Parser::primary()
 {
     if (match(TokenType::NOW))
     {
-       return std::make_shared<NowExpr>();
+       return create<NowExpr>();
     }
 
 
@@ -383,46 +515,46 @@ std::shared_ptr<Expr> Parser::primary()
     if (match(TokenType::FALSE))
     {
         
-          return  Factory::Instance().createBoolLiteral(false);
+          return  create<LiteralExpr>(false);
     }
     if (match(TokenType::TRUE))
     {
           
-          return Factory::Instance().createBoolLiteral(true);
+          return create<LiteralExpr>(true);
    
     }
     if (match(TokenType::NIL))
     {
    
-        return Factory::Instance().createIntegerLiteral(0);
+        return create<LiteralExpr>((long)0);
    
     }
     if (match(TokenType::STRING))
     {
         std::string value = previous().literal;
      
-        return Factory::Instance().createStringLiteral(value);
+        return create<LiteralExpr>(value);
     }
     
     if (match(TokenType::FLOAT))
     {
         double value =std::stod(previous().literal);
        
-        return Factory::Instance().createFloatLiteral(value);
+        return create<LiteralExpr>(value);
     }
 
     if (match(TokenType::INT))
     {
         int value = std::stoi(previous().literal);
        
-        return Factory::Instance().createIntegerLiteral(value);
+        return create<LiteralExpr>((long)value);
     }
 
     if (match(TokenType::BYTE))
     {
         int value = std::stoi(previous().literal);
        
-        return Factory::Instance().createByteLiteral(value);
+        return create<LiteralExpr>((unsigned char)value);
     }
 
   
@@ -430,15 +562,15 @@ std::shared_ptr<Expr> Parser::primary()
 
     if (match(TokenType::IDENTIFIER))
     {
-         std::shared_ptr<VariableExpr> expr = std::make_shared<VariableExpr>(previous());
+         std::shared_ptr<VariableExpr> expr = create<VariableExpr>(previous());
         if (match(TokenType::INC))
         {
             Token op = previous();
-            return std::make_shared<UnaryExpr>(expr, op,false);
+            return create<UnaryExpr>(expr, op,false);
         } else  if (match(TokenType::DEC))
         {
             Token op = previous();
-            return std::make_shared<UnaryExpr>(expr, op,false);
+            return create<UnaryExpr>(expr, op,false);
          } 
         //else if (match(TokenType::LEFT_PAREN) )
         //  {
@@ -453,10 +585,10 @@ std::shared_ptr<Expr> Parser::primary()
     {
         std::shared_ptr<Expr> expr = expression();
         consume(TokenType::RIGHT_PAREN,"Expect ')' after expression.");
-        return std::make_shared<GroupingExpr>(expr);
+        return create<GroupingExpr>(expr);
     }
     
-    return std::make_shared<EmptyExpr>();
+    return create<EmptyExpr>();
 
     
 }
@@ -504,6 +636,11 @@ std::shared_ptr<Stmt> Parser::statement()
         return continueStmt();
     }
 
+    if (match(TokenType::FRAME))
+    {
+        return frameStmt();
+    }
+
 
     if (match(TokenType::LOOP))
     {
@@ -534,7 +671,7 @@ std::shared_ptr<ReturnStmt> Parser::returnStmt()
 {
     std::shared_ptr<Expr> exp = expression();
     consume(TokenType::SEMICOLON,"Expect ';' after expression.");
-    return std::make_shared<ReturnStmt>(std::move(exp));
+    return create<ReturnStmt>(std::move(exp));
 }
 std::shared_ptr<IfStmt> Parser::ifStmt()
 {
@@ -559,7 +696,7 @@ std::shared_ptr<IfStmt> Parser::ifStmt()
         elseBranch = statement();
     }
     
-    return std::make_shared<IfStmt>(std::move(condition), std::move(thenBranch), std::move(elseBranch), std::move(elifBranch));
+    return create<IfStmt>(std::move(condition), std::move(thenBranch), std::move(elseBranch), std::move(elifBranch));
 }
 
 std::shared_ptr<ForStmt> Parser::forStmt()
@@ -606,7 +743,7 @@ std::shared_ptr<ForStmt> Parser::forStmt()
 
     std::shared_ptr<Stmt> body = statement();
 
-    return std::make_shared<ForStmt>(std::move(initializer), std::move(condition), std::move(step), std::move(body));
+    return create<ForStmt>(std::move(initializer), std::move(condition), std::move(step), std::move(body));
 }
 
 std::shared_ptr<WhileStmt> Parser::whileStmt()
@@ -616,7 +753,7 @@ std::shared_ptr<WhileStmt> Parser::whileStmt()
     consume(TokenType::RIGHT_PAREN, "Expect ')' after condition.");
     std::shared_ptr<Stmt> body = statement();
 
-    return std::make_shared<WhileStmt>(std::move(condition), std::move(body));
+    return create<WhileStmt>(std::move(condition), std::move(body));
 
 }
 
@@ -626,7 +763,7 @@ std::shared_ptr<PrintStmt> Parser::printStmt()
     std::shared_ptr<Expr> exp = expression();
     consume(TokenType::RIGHT_PAREN,"Expect ')' after value.");
     consume(TokenType::SEMICOLON,"Expect ';' after value.");
-    return std::make_shared<PrintStmt>(std::move(exp));
+    return create<PrintStmt>(std::move(exp));
 }
 
 std::shared_ptr<BlockStmt> Parser::blockStmt()
@@ -634,14 +771,16 @@ std::shared_ptr<BlockStmt> Parser::blockStmt()
     
     std::vector<std::shared_ptr<Stmt>> statements;
 
+    beginScope();
      while (!check(TokenType::END) && !isAtEnd()) 
     {
     
         statements.push_back(declaration());
     }
+    endScope();
     consume(TokenType::END,"Expect 'end' after block.");
     match(TokenType::SEMICOLON);
-    return std::make_shared<BlockStmt>(std::move(statements));
+    return create<BlockStmt>(std::move(statements));
 }
 
 std::shared_ptr<Program> Parser::programStmt()
@@ -661,8 +800,9 @@ std::shared_ptr<Program> Parser::programStmt()
     
     std::shared_ptr<Stmt> block = statement();
     consume(TokenType::DOT,"Expect '.' after end of program block.");
+    resolveFields();
 
-    return std::make_shared<Program>(nameStr, std::move(statements), std::move(block));
+    return create<Program>(nameStr, std::move(statements), std::move(block));
     
 }
 
@@ -692,7 +832,7 @@ std::shared_ptr<SwitchStmt> Parser::switchStmt()
 
     consume(TokenType::END,"Expect 'end' after switch block.");
    
-    return std::make_shared<SwitchStmt>(std::move(expr), std::move(default_case), std::move(cases));
+    return create<SwitchStmt>(std::move(expr), std::move(default_case), std::move(cases));
 
 }
 
@@ -705,7 +845,7 @@ std::shared_ptr<RepeatStmt> Parser::repeatStmt()
     std::shared_ptr<Expr> exp = expression();
     
     consume(TokenType::RIGHT_PAREN,"Expect ')' after condition.");
-    return std::make_shared<RepeatStmt>(std::move(exp), std::move(body));
+    return create<RepeatStmt>(std::move(exp), std::move(body));
     
 }
 
@@ -713,18 +853,30 @@ std::shared_ptr<LoopStmt> Parser::loopStmt()
 {
         match(TokenType::SEMICOLON);
         std::shared_ptr<Stmt> body = statement();
-        return std::make_shared<LoopStmt>(std::move(body));
+        return create<LoopStmt>(std::move(body));
 }
 
 std::shared_ptr<BreakStmt> Parser::breakStmt()
 {
 
-    return std::make_shared<BreakStmt>();
+    return create<BreakStmt>();
 }
 
 std::shared_ptr<ContinueStmt> Parser::continueStmt()
 {
-    return std::make_shared<ContinueStmt>();
+    return create<ContinueStmt>();
+}
+
+std::shared_ptr<FrameStmt> Parser::frameStmt()
+{
+    std::shared_ptr<Expr> percent = nullptr;
+    if (match(TokenType::LEFT_PAREN))
+    {
+        percent = expression();
+        consume(TokenType::RIGHT_PAREN, "Expect ')' after frame percent.");
+    }
+    match(TokenType::SEMICOLON);
+    return create<FrameStmt>(std::move(percent));
 }
 
 std::shared_ptr<FunctionStmt> Parser::functionStmt()
@@ -744,38 +896,45 @@ std::shared_ptr<FunctionStmt> Parser::functionStmt()
             {
                     Token name = consume(TokenType::IDENTIFIER, "Expect variable name.");
                     
-                    std::shared_ptr<LiteralExpr> expr = Factory::Instance().Instance().createIntegerLiteral(DEFAULT_INT);
-                    std::shared_ptr<Argument> arg = std::make_shared<Argument>(name.literal, std::move(expr));
+                    std::shared_ptr<LiteralExpr> expr = create<LiteralExpr>(DEFAULT_INT);
+                    std::shared_ptr<Argument> arg = create<Argument>(name.literal, std::move(expr));
                     parameter.push_back(arg);
 
             } else 
             if (match(TokenType::IDFLOAT))
             {
                     Token name = consume(TokenType::IDENTIFIER, "Expect variable name.");
-                    std::shared_ptr<LiteralExpr> expr = Factory::Instance().Instance().createFloatLiteral(DEFAULT_FLOAT);
-                    std::shared_ptr<Argument> arg = std::make_shared<Argument>(name.literal, std::move(expr));
+                    std::shared_ptr<LiteralExpr> expr = create<LiteralExpr>(DEFAULT_FLOAT);
+                    std::shared_ptr<Argument> arg = create<Argument>(name.literal, std::move(expr));
                     parameter.push_back(arg);
             } else
             if (match(TokenType::IDBYTE))
             {
                     Token name = consume(TokenType::IDENTIFIER, "Expect variable name.");
-                    std::shared_ptr<LiteralExpr> expr = Factory::Instance().Instance().createByteLiteral(DEFAULT_BYTE);
-                    std::shared_ptr<Argument> arg = std::make_shared<Argument>(name.literal, std::move(expr));
+                    std::shared_ptr<LiteralExpr> expr = create<LiteralExpr>(DEFAULT_BYTE);
+                    std::shared_ptr<Argument> arg = create<Argument>(name.literal, std::move(expr));
                     parameter.push_back(arg);
             } else
             if (match(TokenType::IDSTRING))
             {
                 Token name = consume(TokenType::IDENTIFIER, "Expect variable name.");
-                std::shared_ptr<LiteralExpr> expr = Factory::Instance().Instance().createStringLiteral(DEFAULT_STRING);
-                std::shared_ptr<Argument> arg = std::make_shared<Argument>(name.literal, std::move(expr));
+                std::shared_ptr<LiteralExpr> expr = create<LiteralExpr>(DEFAULT_STRING);
+                std::shared_ptr<Argument> arg = create<Argument>(name.literal, std::move(expr));
                 parameter.push_back(arg);
                
             } else 
             if (match(TokenType::IDBOOL))
             {
                     Token name = consume(TokenType::IDENTIFIER, "Expect variable name.");
-                    std::shared_ptr<LiteralExpr> expr = Factory::Instance().Instance().createBoolLiteral(false);
-                    std::shared_ptr<Argument> arg = std::make_shared<Argument>(name.literal, std::move(expr));
+                    std::shared_ptr<LiteralExpr> expr = create<LiteralExpr>(false);
+                    std::shared_ptr<Argument> arg = create<Argument>(name.literal, std::move(expr));
+                    parameter.push_back(arg);
+            } else
+            if (match(TokenType::IDVAR))
+            {
+                    Token name = consume(TokenType::IDENTIFIER, "Expect variable name.");
+                    std::shared_ptr<LiteralExpr> expr = create<LiteralExpr>((HeapObject *)nullptr);
+                    std::shared_ptr<Argument> arg = create<Argument>(name.literal, std::move(expr));
                     parameter.push_back(arg);
             }
         } while (match(TokenType::COMMA));
@@ -821,8 +980,11 @@ std::shared_ptr<FunctionStmt> Parser::functionStmt()
 
 
 
+    beginScope();
+    declare(parameter);
     std::shared_ptr<Stmt> body = statement();
-    return std::make_shared<FunctionStmt>(nameStr, returnType, std::move(parameter), std::move(body));
+    endScope();
+    return create<FunctionStmt>(nameStr, returnType, std::move(parameter), std::move(body));
 }
 
 
@@ -844,36 +1006,43 @@ std::shared_ptr<ProcedureStmt> Parser::procedureStmt()
             {
                     Token name = consume(TokenType::IDENTIFIER, "Expect variable name.");
                     
-                    std::shared_ptr<LiteralExpr> expr = Factory::Instance().Instance().createIntegerLiteral(DEFAULT_INT);
-                    std::shared_ptr<Argument> arg = std::make_shared<Argument>(name.literal, std::move(expr));
+                    std::shared_ptr<LiteralExpr> expr = create<LiteralExpr>(DEFAULT_INT);
+                    std::shared_ptr<Argument> arg = create<Argument>(name.literal, std::move(expr));
                     parameter.push_back(arg);
 
             } else if (match(TokenType::IDFLOAT))
             {
                     Token name = consume(TokenType::IDENTIFIER, "Expect variable name.");
-                    std::shared_ptr<LiteralExpr> expr = Factory::Instance().Instance().createFloatLiteral(DEFAULT_FLOAT);
-                    std::shared_ptr<Argument> arg = std::make_shared<Argument>(name.literal, std::move(expr));
+                    std::shared_ptr<LiteralExpr> expr = create<LiteralExpr>(DEFAULT_FLOAT);
+                    std::shared_ptr<Argument> arg = create<Argument>(name.literal, std::move(expr));
                     parameter.push_back(arg);
             }  else if (match(TokenType::IDBYTE))
             {
                     Token name = consume(TokenType::IDENTIFIER, "Expect variable name.");
-                    std::shared_ptr<LiteralExpr> expr = Factory::Instance().Instance().createByteLiteral(DEFAULT_BYTE);
-                    std::shared_ptr<Argument> arg = std::make_shared<Argument>(name.literal, std::move(expr));
+                    std::shared_ptr<LiteralExpr> expr = create<LiteralExpr>(DEFAULT_BYTE);
+                    std::shared_ptr<Argument> arg = create<Argument>(name.literal, std::move(expr));
                     parameter.push_back(arg);
             }else 
             if (match(TokenType::IDSTRING))
             {
                 Token name = consume(TokenType::IDENTIFIER, "Expect variable name.");
-                std::shared_ptr<LiteralExpr> expr = Factory::Instance().Instance().createStringLiteral(DEFAULT_STRING);
-                std::shared_ptr<Argument> arg = std::make_shared<Argument>(name.literal, std::move(expr));
+                std::shared_ptr<LiteralExpr> expr = create<LiteralExpr>(DEFAULT_STRING);
+                std::shared_ptr<Argument> arg = create<Argument>(name.literal, std::move(expr));
                 parameter.push_back(arg);
                
             } else 
             if (match(TokenType::IDBOOL))
             {
                     Token name = consume(TokenType::IDENTIFIER, "Expect variable name.");
-                    std::shared_ptr<LiteralExpr> expr = Factory::Instance().Instance().createBoolLiteral(false);
-                    std::shared_ptr<Argument> arg = std::make_shared<Argument>(name.literal, std::move(expr));
+                    std::shared_ptr<LiteralExpr> expr = create<LiteralExpr>(false);
+                    std::shared_ptr<Argument> arg = create<Argument>(name.literal, std::move(expr));
+                    parameter.push_back(arg);
+            } else
+            if (match(TokenType::IDVAR))
+            {
+                    Token name = consume(TokenType::IDENTIFIER, "Expect variable name.");
+                    std::shared_ptr<LiteralExpr> expr = create<LiteralExpr>((HeapObject *)nullptr);
+                    std::shared_ptr<Argument> arg = create<Argument>(name.literal, std::move(expr));
                     parameter.push_back(arg);
             }
         } while (match(TokenType::COMMA));
@@ -885,8 +1054,11 @@ std::shared_ptr<ProcedureStmt> Parser::procedureStmt()
         Error(tokens[current],"Expect 'begin'  ");
     }
 
+    beginScope();
+    declare(parameter);
     std::shared_ptr<Stmt> body = statement();
-    return std::make_shared<ProcedureStmt>(nameStr, std::move(parameter), std::move(body));
+    endScope();
+    return create<ProcedureStmt>(nameStr, std::move(parameter), std::move(body));
 }
 
 
@@ -910,7 +1082,7 @@ std::shared_ptr<ProcedureCallStmt> Parser::procedureCall()
             
     }while (!check(TokenType::RIGHT_PAREN) || !isAtEnd());
     consume(TokenType::SEMICOLON, "Expect ';' after procedure arguments.");
-    return std::make_shared<ProcedureCallStmt>(name, std::move(arguments));
+    return create<ProcedureCallStmt>(name, std::move(arguments));
 }
 
 std::shared_ptr<CallerExpr> Parser::processCall()
@@ -940,7 +1112,7 @@ std::shared_ptr<CallerExpr> Parser::processCall()
     }while (!check(TokenType::RIGHT_PAREN) || !isAtEnd());
 
     unsigned int arity = arguments.size();
-    return std::make_shared<CallerExpr>(name,line, std::move(arguments), arity,0);
+    return create<CallerExpr>(name,line, std::move(arguments), arity,0);
 }
 
 
@@ -971,7 +1143,7 @@ std::shared_ptr<CallerExpr> Parser::nativeFunctionCall()
     }while (!check(TokenType::RIGHT_PAREN) || !isAtEnd());
 
     unsigned int arity = arguments.size();
-    return std::make_shared<CallerExpr>(name,line, std::move(arguments), arity,2);
+    return create<CallerExpr>(name,line, std::move(arguments), arity,2);
 }
 
 std::shared_ptr<CallerExpr> Parser::functionCall()
@@ -1004,7 +1176,7 @@ std::shared_ptr<CallerExpr> Parser::functionCall()
 
     unsigned int arity = arguments.size();
     
-    return std::make_shared<CallerExpr>(name,line, std::move(arguments), arity,1);
+    return create<CallerExpr>(name,line, std::move(arguments), arity,1);
   
 }
 
@@ -1024,37 +1196,44 @@ std::shared_ptr<ProcessStmt> Parser::processStmt()
             {
                     Token name = consume(TokenType::IDENTIFIER, "Expect variable name.");
                     
-                    std::shared_ptr<LiteralExpr> expr = Factory::Instance().Instance().createIntegerLiteral(DEFAULT_INT);
-                    std::shared_ptr<Argument> arg = std::make_shared<Argument>(name.literal, std::move(expr));
+                    std::shared_ptr<LiteralExpr> expr = create<LiteralExpr>(DEFAULT_INT);
+                    std::shared_ptr<Argument> arg = create<Argument>(name.literal, std::move(expr));
                     parameter.push_back(arg);
 
             } else if (match(TokenType::IDFLOAT))
             {
                     Token name = consume(TokenType::IDENTIFIER, "Expect variable name.");
-                    std::shared_ptr<LiteralExpr> expr = Factory::Instance().Instance().createFloatLiteral(DEFAULT_FLOAT);
-                    std::shared_ptr<Argument> arg = std::make_shared<Argument>(name.literal, std::move(expr));
+                    std::shared_ptr<LiteralExpr> expr = create<LiteralExpr>(DEFAULT_FLOAT);
+                    std::shared_ptr<Argument> arg = create<Argument>(name.literal, std::move(expr));
                     parameter.push_back(arg);
             }else 
             if (match(TokenType::IDBYTE))
             {
                     Token name = consume(TokenType::IDENTIFIER, "Expect variable name.");
-                    std::shared_ptr<LiteralExpr> expr = Factory::Instance().Instance().createByteLiteral(DEFAULT_BYTE);
-                    std::shared_ptr<Argument> arg = std::make_shared<Argument>(name.literal, std::move(expr));
+                    std::shared_ptr<LiteralExpr> expr = create<LiteralExpr>(DEFAULT_BYTE);
+                    std::shared_ptr<Argument> arg = create<Argument>(name.literal, std::move(expr));
                     parameter.push_back(arg);
             }else
             if (match(TokenType::IDSTRING))
             {
                 Token name = consume(TokenType::IDENTIFIER, "Expect variable name.");
-                std::shared_ptr<LiteralExpr> expr = Factory::Instance().Instance().createStringLiteral(DEFAULT_STRING);
-                std::shared_ptr<Argument> arg = std::make_shared<Argument>(name.literal, std::move(expr));
+                std::shared_ptr<LiteralExpr> expr = create<LiteralExpr>(DEFAULT_STRING);
+                std::shared_ptr<Argument> arg = create<Argument>(name.literal, std::move(expr));
                 parameter.push_back(arg);
                
             } else 
             if (match(TokenType::IDBOOL))
             {
                     Token name = consume(TokenType::IDENTIFIER, "Expect variable name.");
-                    std::shared_ptr<LiteralExpr> expr = Factory::Instance().Instance().createBoolLiteral(false);
-                    std::shared_ptr<Argument> arg = std::make_shared<Argument>(name.literal, std::move(expr));
+                    std::shared_ptr<LiteralExpr> expr = create<LiteralExpr>(false);
+                    std::shared_ptr<Argument> arg = create<Argument>(name.literal, std::move(expr));
+                    parameter.push_back(arg);
+            } else
+            if (match(TokenType::IDVAR))
+            {
+                    Token name = consume(TokenType::IDENTIFIER, "Expect variable name.");
+                    std::shared_ptr<LiteralExpr> expr = create<LiteralExpr>((HeapObject *)nullptr);
+                    std::shared_ptr<Argument> arg = create<Argument>(name.literal, std::move(expr));
                     parameter.push_back(arg);
             }
         } while (match(TokenType::COMMA));
@@ -1066,8 +1245,64 @@ std::shared_ptr<ProcessStmt> Parser::processStmt()
         Error(tokens[current],"Expect 'begin'  ");
     }
 
+    beginScope();
+    for (int i = 0; processLocals[i].name != NULL; i++)
+    {
+        declare(processLocals[i].name, processLocals[i].type);
+    }
+    declare(parameter);
     std::shared_ptr<Stmt> body = statement();
-    return std::make_shared<ProcessStmt>(nameStr, std::move(parameter), std::move(body));
+    endScope();
+    std::shared_ptr<ProcessStmt> process = create<ProcessStmt>(nameStr, std::move(parameter), std::move(body));
+    for (auto &arg : process->parameter)
+    {
+        process->locals.push_back(arg->name);
+    }
+    if (process->body && process->body->getType() == StmtType::BLOCK)
+    {
+        for (auto &stmt : static_cast<BlockStmt *>(process->body.get())->declarations)
+        {
+            if (stmt && stmt->getType() == StmtType::VAR)
+            {
+                for (auto &token : static_cast<VarStmt *>(stmt.get())->names)
+                {
+                    process->locals.push_back(token.lexeme);
+                }
+            }
+        }
+    }
+    processes.push_back(process.get());
+    return process;
+}
+
+int Parser::fieldId(const std::string &name)
+{
+    auto it = fieldIds.find(name);
+    if (it != fieldIds.end())
+    {
+        return it->second;
+    }
+    int id = (int)fieldIds.size();
+    fieldIds[name] = id;
+    return id;
+}
+
+// Once the whole program is read every field id is known: each process type
+// gets the index of its own local for the ids it declares.
+void Parser::resolveFields()
+{
+    for (ProcessStmt *process : processes)
+    {
+        process->fields.assign(fieldIds.size(), -1);
+        for (size_t i = 0; i < process->locals.size(); i++)
+        {
+            auto it = fieldIds.find(process->locals[i]);
+            if (it != fieldIds.end() && process->fields[it->second] < 0)
+            {
+                process->fields[it->second] = (int)i;
+            }
+        }
+    }
 }
 
 
@@ -1079,12 +1314,12 @@ std::shared_ptr<ExpressionStmt> Parser::expressionStatement()
      
     std::shared_ptr<Expr> expr = expression();
     consume(TokenType::SEMICOLON,"Expect ';' after expression statement.");
-    return std::make_shared<ExpressionStmt>(std::move(expr));
+    return create<ExpressionStmt>(std::move(expr));
 }
 
 std::shared_ptr<EmptyStmt> Parser::emptyDeclaration()
 {
-    return std::make_shared<EmptyStmt>();
+    return create<EmptyStmt>();
 }
 
 std::shared_ptr<Stmt> Parser::declaration()
@@ -1110,6 +1345,10 @@ std::shared_ptr<Stmt> Parser::declaration()
     if (match(TokenType::IDBOOL))
     {
         return varDeclaration(LiteralType::BOOLEAN);
+    } else 
+    if (match(TokenType::IDVAR))
+    {
+        return varDeclaration(LiteralType::OBJECT);
     }
     return statement();
 }
@@ -1164,23 +1403,27 @@ std::shared_ptr<VarStmt> Parser::varDeclaration(LiteralType type)
 
             if (type == LiteralType::INT)
             {
-                initializer = Factory::Instance().Instance().createIntegerLiteral(DEFAULT_INT);
+                initializer = create<LiteralExpr>(DEFAULT_INT);
             } else 
             if (type == LiteralType::FLOAT)
             {
-                initializer = Factory::Instance().Instance().createFloatLiteral(DEFAULT_FLOAT);
+                initializer = create<LiteralExpr>(DEFAULT_FLOAT);
             } else 
             if (type == LiteralType::BYTE)
             {
-                initializer = Factory::Instance().Instance().createByteLiteral(DEFAULT_BYTE);
+                initializer = create<LiteralExpr>(DEFAULT_BYTE);
             } else
             if (type == LiteralType::STRING)
             {
-                initializer =Factory::Instance().Instance().createStringLiteral(DEFAULT_STRING);
+                initializer =create<LiteralExpr>(DEFAULT_STRING);
             } else 
             if (type == LiteralType::BOOLEAN)
             {
-                initializer =Factory::Instance().Instance().createBoolLiteral(false);
+                initializer =create<LiteralExpr>(false);
+            } else 
+            if (type == LiteralType::OBJECT)
+            {
+                initializer =create<LiteralExpr>((HeapObject *)nullptr);
             } else 
             {
                 Warning(name,"Type not supported for variable assign");
@@ -1189,7 +1432,15 @@ std::shared_ptr<VarStmt> Parser::varDeclaration(LiteralType type)
 
     }
     consume(TokenType::SEMICOLON, "Expect ';' after variable declaration.");
-    return std::make_shared<VarStmt>(names, std::move(initializer), type);
+    if (initializer)
+    {
+        initializer = fold(initializer, type, name);
+    }
+    for (const Token &token : names)
+    {
+        declare(token.lexeme, type);
+    }
+    return create<VarStmt>(names, std::move(initializer), type);
 }
 
 
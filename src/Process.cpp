@@ -15,6 +15,11 @@ Process::Process(Interpreter *i,const std::string &name, long ID,size_t index)
     this->interpreter = i;
     this->index = index;
     this->name = name;
+    reset(ID);
+}
+
+void Process::reset(long ID)
+{
     this->ID = ID;
     this->m_running = true;
     this->graph = 0;
@@ -22,194 +27,276 @@ Process::Process(Interpreter *i,const std::string &name, long ID,size_t index)
     this->instance = Scene::Get().CreateInstance(ID, name, graph, 0, 0, 0, layer);
     _lastGraph = -1;
     _lastLayer = -1;
+    // the new instance takes every built-in
+    dirty = ~0u;
     parent = nullptr;
-
-    if (interpreter->getContext())
-    {
-        parent = interpreter->getContext()->getInternalProcess();
-        //if (parent)
-        //    Log(0, "Create Process(%s) id(%d) parent  id(%d) name(%s)", name.c_str(), ID, parent->ID, parent->name.c_str());
-    }
-
-    
-
-    state = 0;
-
-
-
-  
-
-
-    
+    firstChild = nullptr;
+    lastChild = nullptr;
+    prevSibling = nullptr;
+    nextSibling = nullptr;
+
+    frames.clear();
+    started = false;
+    frameCredit = 0;
+    framePercent = 100;
+    sleepClock = CLOCK_NONE;
+    wakeAt = 0;
+    nextTick = -1;
+    parked = false;
+    sequence = 0;
+    signalState = SIGNAL_NONE;
+    mailbox.clear();
+    inbox.clear();
+    lastSender = 0;
+    typePrev = nullptr;
+    typeNext = nullptr;
+    cursor = {-1, 0};
+    random.seed(interpreter->getRandomSeed(), (uint64_t)ID);
 }
 
-
-
-
 Process::~Process()
 {
     instance = nullptr;
     //  std::cout<<"Delete Process("<<ID<<")"<<std::endl;
 }
 
-void Process::run()
-{
-    if (!m_running)  return;
-
-
-    interpreter->enterLocal(environment);
- 
-     //
-
-     
-     //environment->print();
-
- 
-
-     try
-     {
-         switch (state)
-         {
-         case 0:
-         {
-                    this->interpreter->processInitExecute(index);
-                    // for (auto &stmt : initialStatements)
-                    // {
-                    //     interpreter->execute(stmt);
-                    // }
-                    pre_run();
-             state = 1;
-             break;
-         }
-         case 1:
-         {
-             try
-             {
-
-                 try
-                 {
-                     pre_run();
-                     interpreter->processLoopExecute(index);
-                     post_run();
-                 }
-                 catch (ContinueException &)
-                 {
-                     // Do nothing, just continue the loop
-                 }
-             }
-             catch (BreakException &)
-             {
-
-                 state = 2;
-             }
-
-             
-         }
-         break;
-         case 2:
-         {
-            pre_run();
-            interpreter->processEndExecute(index);
-            //  for (auto &stmt : finalStatements)
-            //  {
-            //      interpreter->execute(stmt);
-            //  }
-             post_run();
-             state = 3;
-             break;
-         }
-         case 3:
-         {
-            if (this->instance!=nullptr)
-               this->instance->Destroy();
-             m_running = false;
-             break;
-         }
-         }
-       
-     }
-     catch (ReturnException &returnValue)
-     {
-        state = 3;
-     }
-
-     pre_run();
-     post_run();
-
-     interpreter->exitBlock();
-
-     //  environment->print();
-     
+bool Process::run()
+{
+    if (!m_running)  return false;
 
+    takeMessages();
+    if (!m_running || signalState != SIGNAL_NONE)
+    {
+        return false;
+    }
 
+    frameCredit += 100;
+    if (frameCredit <= 0)
+    {
+        return false;
+    }
 
+    bool suspended = true;
+    while (frameCredit > 0)
+    {
+        suspended = interpreter->resumeProcess(this);
+        if (!m_running)
+        {
+            break;
+        }
+        // the instance takes what the pass left in the locals, also between
+        // the passes of a frame(n) under 100
+        pre_run();
+        if (!suspended || sleeping())
+        {
+            break;
+        }
+        frameCredit -= framePercent;
+    }
+    if (!m_running)  return true;
 
+    if (!suspended)
+    {
+        kill();
+    }
+    if (m_running && !sleeping())
+    {
+        pace();
+    }
+    return true;
 }
 
-void Process::pre_run()
+// A process with a tick_rate sleeps on the millisecond wheel until its next
+// tick. The first one is offset by a golden ratio fraction of the period on
+// the spawn sequence, so processes of one rate spawned together spread over
+// the frames of the period instead of all ticking on the same one. Later
+// ticks keep that phase, a process that fell behind skips the missed ones.
+void Process::pace()
 {
+    double rate = environment->builtin(LOCAL_TICK_RATE).getFloat();
+    if (rate <= 0)
+    {
+        nextTick = -1;
+        return;
+    }
+    double period = 1000.0 / rate;
+    double now = interpreter->gameTime;
+    if (nextTick < 0)
+    {
+        nextTick = now + period * std::fmod(sequence * 0.6180339887, 1.0);
+    }
+    else
+    {
+        nextTick += period;
+    }
+    if (nextTick <= now)
+    {
+        nextTick += period * (std::floor((now - nextTick) / period) + 1);
+    }
+    sleepClock = CLOCK_MILLIS;
+    wakeAt = (int64_t)std::ceil(nextTick);
+}
 
-    this->instance->x = environment->get("x")->getFloat();
-    this->instance->y = environment->get("y")->getFloat();
-    this->instance->angle = environment->get("angle")->getFloat();
+void Process::kill()
+{
+    if (!m_running)
+        return;
+    if (this->instance != nullptr)
+        this->instance->Destroy();
+    m_running = false;
+    if (parked)
+        interpreter->processes.bury(this);
+}
 
-    this->instance->scale.x = environment->get("scale_x")->getFloat();
-    this->instance->scale.y = environment->get("scale_y")->getFloat();
-    
-    this->instance->skew.x = environment->get("skew_x")->getFloat();
-    this->instance->skew.y = environment->get("skew_y")->getFloat();
-    
-    this->instance->color.r = environment->get("red")->getByte();
-    this->instance->color.g = environment->get("green")->getByte();
-    this->instance->color.b = environment->get("blue")->getByte();
-    this->instance->color.a = environment->get("alpha")->getByte();
+void Process::sleep(double ms)
+{
+    sleepClock = CLOCK_MILLIS;
+    wakeAt = (int64_t)std::ceil(interpreter->gameTime + std::max(0.0, ms));
+}
 
-    this->instance->showBox = environment->get("show_box")->getBool();
+void Process::wait_frames(long frames)
+{
+    sleepClock = CLOCK_FRAMES;
+    wakeAt = interpreter->frameNumber + std::max(1L, frames);
+}
 
-    this->instance->visible = environment->get("visible")->getBool();
-    this->instance->active = environment->get("active")->getBool();
-    
+void Process::post(int signal, const Literal &value, long sender)
+{
+    mailbox.post({signal, value, sender});
+}
 
+// Signals act in the order they were sent, s_sleep hides the instance and
+// s_freeze leaves it on screen; pre_run restores the visibility once the
+// process ticks again.
+void Process::takeMessages()
+{
+    Message message;
+    while (mailbox.take(message))
+    {
+        switch (message.signal)
+        {
+        case SIGNAL_KILL:
+            kill();
+            return;
+        case SIGNAL_WAKEUP:
+            signalState = SIGNAL_NONE;
+            touch(LOCAL_VISIBLE);
+            break;
+        case SIGNAL_SLEEP:
+            signalState = SIGNAL_SLEEP;
+            instance->visible = false;
+            break;
+        case SIGNAL_FREEZE:
+            signalState = SIGNAL_FREEZE;
+            instance->visible = environment->builtin(LOCAL_VISIBLE).getBool();
+            break;
+        default:
+            inbox.push_back(message);
+            break;
+        }
+    }
+}
 
-    layer = environment->get("layer")->getInt();
-    graph =  environment->get("graph")->getInt();
-    if (_lastGraph != graph)
+// The parent is being freed: an instance attached to it with set_parent()
+// stays where it was on screen, in world coordinates.
+void Process::leaveParent()
+{
+    if (!instance || !parent || instance->m_parent != parent->instance)
     {
-        _lastGraph = graph;
-        this->instance->setGraph(graph);
+        return;
     }
-    if (_lastLayer !=layer) 
+    instance->detach();
+    Literal *local = &environment->builtin(0);
+    local[LOCAL_X].setFloat(instance->x);
+    local[LOCAL_Y].setFloat(instance->y);
+    local[LOCAL_ANGLE].setFloat(instance->angle);
+}
+
+bool Process::receive(Literal &value)
+{
+    if (inbox.empty())
     {
-        _lastLayer = layer;
-        this->instance->layer = layer;
+        return false;
     }
+    value = inbox.front().value;
+    lastSender = inbox.front().sender;
+    inbox.pop_front();
+    return true;
 }
 
-void Process::post_run()
+// The built-ins sit in fixed slots of the process environment, the sync
+// with the instance copies the slots written since the last one.
+void Process::pre_run()
 {
-    environment->get("x")->setFloat(instance->x);
-    environment->get("y")->setFloat(instance->y);
-    environment->get("angle")->setFloat(instance->angle);
+    if (!dirty)
+    {
+        return;
+    }
+    Literal *local = &environment->builtin(0);
+    const uint32_t changed = dirty;
+    dirty = 0;
+
+    if (changed & (1u << LOCAL_X))
+        this->instance->x = local[LOCAL_X].getFloat();
+    if (changed & (1u << LOCAL_Y))
+        this->instance->y = local[LOCAL_Y].getFloat();
+    if (changed & (1u << LOCAL_ANGLE))
+        this->instance->angle = local[LOCAL_ANGLE].getFloat();
+
+    if (changed & (1u << LOCAL_SCALE_X))
+        this->instance->scale.x = local[LOCAL_SCALE_X].getFloat();
+    if (changed & (1u << LOCAL_SCALE_Y))
+        this->instance->scale.y = local[LOCAL_SCALE_Y].getFloat();
     
-    // environment->get("scale_x")->setFloat(instance->scale.x);
-    // environment->get("scale_y")->setFloat(instance->scale.y);
+    if (changed & (1u << LOCAL_SKEW_X))
+        this->instance->skew.x = local[LOCAL_SKEW_X].getFloat();
+    if (changed & (1u << LOCAL_SKEW_Y))
+        this->instance->skew.y = local[LOCAL_SKEW_Y].getFloat();
     
-    // environment->get("skew_x")->setFloat(instance->skew.x);
-    // environment->get("skew_y")->setFloat(instance->skew.y);
-
-
-    // environment->get("red")->setByte(instance->color.r);
-    // environment->get("green")->setByte(instance->color.g);
-    // environment->get("blue")->setByte(instance->color.b);
-    // environment->get("alpha")->setByte(instance->color.a);
-
-    // environment->get("show_box")->setBool(instance->showBox);
-
-    // environment->get("visible")->setBool(instance->visible);
-    // environment->get("active")->setBool(instance->active);
+    if (changed & (1u << LOCAL_RED))
+        this->instance->color.r = local[LOCAL_RED].getByte();
+    if (changed & (1u << LOCAL_GREEN))
+        this->instance->color.g = local[LOCAL_GREEN].getByte();
+    if (changed & (1u << LOCAL_BLUE))
+        this->instance->color.b = local[LOCAL_BLUE].getByte();
+    if (changed & (1u << LOCAL_ALPHA))
+        this->instance->color.a = local[LOCAL_ALPHA].getByte();
+
+    if (changed & (1u << LOCAL_SHOW_BOX))
+        this->instance->showBox = local[LOCAL_SHOW_BOX].getBool();
+
+    if (changed & (1u << LOCAL_VISIBLE))
+        this->instance->visible = local[LOCAL_VISIBLE].getBool();
+    if (changed & (1u << LOCAL_ACTIVE))
+        this->instance->active = local[LOCAL_ACTIVE].getBool();
+
+    if (changed & (1u << LOCAL_GRAPH))
+    {
+        graph = local[LOCAL_GRAPH].getInt();
+        if (_lastGraph != graph)
+        {
+            _lastGraph = graph;
+            this->instance->setGraph(graph);
+        }
+    }
+    if (changed & (1u << LOCAL_LAYER))
+    {
+        layer = local[LOCAL_LAYER].getInt();
+        if (_lastLayer != layer)
+        {
+            _lastLayer = layer;
+            this->instance->layer = layer;
+        }
+    }
+}
 
-    
+void Process::post_run()
+{
+    Literal *local = &environment->builtin(0);
 
+    local[LOCAL_X].setFloat(instance->x);
+    local[LOCAL_Y].setFloat(instance->y);
+    local[LOCAL_ANGLE].setFloat(instance->angle);
 }
 
 void Process::render()
@@ -230,20 +317,39 @@ bool Process::define(const std::string &name, const Literal &value)
     return this->environment->define(name, value);
 }
 
+// The natives move the process through its locals, which the script may
+// have written earlier in the tick, and pre_run hands them to the instance.
 void Process::advance(double speed)
 {   
-    this->instance->x += speed *  cos_deg(this->instance->angle);
-    this->instance->y += speed * -sin_deg(this->instance->angle);
-
+    xadvance(speed, getAngle());
 }
 
 void Process::xadvance(double speed, double _angle)
 {
-    this->instance->x += speed * cos_deg(_angle);
-    this->instance->y += speed * -sin_deg(_angle);
+    Literal *local = &environment->builtin(0);
+    local[LOCAL_X].setFloat(local[LOCAL_X].getFloat() + speed * cos_deg(_angle));
+    local[LOCAL_Y].setFloat(local[LOCAL_Y].getFloat() + speed * -sin_deg(_angle));
+    touch(LOCAL_X);
+    touch(LOCAL_Y);
 }
 
 void Process::rotate_to(double target_angle, double t) 
 {
-    this->instance->angle = lerp_angle(this->instance->angle, target_angle, t);
+    environment->builtin(LOCAL_ANGLE).setFloat(lerp_angle(getAngle(), target_angle, t));
+    touch(LOCAL_ANGLE);
+}
+
+double Process::getX() const
+{
+    return environment->builtin(LOCAL_X).getFloat();
+}
+
+double Process::getY() const
+{
+    return environment->builtin(LOCAL_Y).getFloat();
+}
+
+double Process::getAngle() const
+{
+    return environment->builtin(LOCAL_ANGLE).getFloat();
 }
\ No newline at end of file
@@ -0,0 +1,244 @@
+#include "pch.h"
+#include "ProcessTable.hpp"
+#include "Process.hpp"
+#include "Utils.hpp"
+
+ProcessTable::ProcessTable() : asleep(0), sequence(0)
+{
+}
+
+ProcessTable::~ProcessTable()
+{
+    clear();
+}
+
+long ProcessTable::allocate()
+{
+    size_t index;
+    if (!freeSlots.empty())
+    {
+        index = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    else
+    {
+        index = slots.size();
+        if (index >= (size_t)IndexMask)
+        {
+            Log(2, "Process table is full (%zu slots)", index);
+            return 0;
+        }
+        slots.push_back({nullptr, 0});
+    }
+    return ((long)slots[index].generation << IndexBits) | (long)(index + 1);
+}
+
+void ProcessTable::link(Process *process)
+{
+    if (process->index >= registries.size())
+    {
+        registries.resize(process->index + 1, {nullptr, nullptr, 0});
+    }
+    Registry &registry = registries[process->index];
+    process->typePrev = registry.last;
+    process->typeNext = nullptr;
+    if (registry.last)
+        registry.last->typeNext = process;
+    else
+        registry.first = process;
+    registry.last = process;
+    registry.size++;
+}
+
+void ProcessTable::unlink(Process *process)
+{
+    Registry &registry = registries[process->index];
+    if (process->typePrev)
+        process->typePrev->typeNext = process->typeNext;
+    else
+        registry.first = process->typeNext;
+    if (process->typeNext)
+        process->typeNext->typePrev = process->typePrev;
+    else
+        registry.last = process->typePrev;
+    process->typePrev = nullptr;
+    process->typeNext = nullptr;
+    registry.size--;
+}
+
+void ProcessTable::addChild(Process *parent, Process *child)
+{
+    child->parent = parent;
+    child->prevSibling = parent->lastChild;
+    child->nextSibling = nullptr;
+    if (parent->lastChild)
+        parent->lastChild->nextSibling = child;
+    else
+        parent->firstChild = child;
+    parent->lastChild = child;
+}
+
+void ProcessTable::removeChild(Process *parent, Process *child)
+{
+    if (child->prevSibling)
+        child->prevSibling->nextSibling = child->nextSibling;
+    else
+        parent->firstChild = child->nextSibling;
+    if (child->nextSibling)
+        child->nextSibling->prevSibling = child->prevSibling;
+    else
+        parent->lastChild = child->prevSibling;
+    child->prevSibling = nullptr;
+    child->nextSibling = nullptr;
+}
+
+void ProcessTable::orphan(Process *process)
+{
+    Process *grand = process->parent;
+    Process *child = process->firstChild;
+    while (child)
+    {
+        Process *next = child->nextSibling;
+        child->leaveParent();
+        child->parent = nullptr;
+        if (grand)
+            addChild(grand, child);
+        else
+            child->prevSibling = child->nextSibling = nullptr;
+        child = next;
+    }
+    process->firstChild = nullptr;
+    process->lastChild = nullptr;
+    if (grand)
+        removeChild(grand, process);
+    process->parent = nullptr;
+}
+
+void ProcessTable::freeSlot(size_t index)
+{
+    if (slots[index].process)
+    {
+        unlink(slots[index].process.get());
+        orphan(slots[index].process.get());
+    }
+    if (slots[index].process && recycle)
+    {
+        recycle(std::move(slots[index].process));
+    }
+    slots[index].process = nullptr;
+    slots[index].generation++;
+    freeSlots.push_back((uint32_t)index);
+}
+
+void ProcessTable::release(long id)
+{
+    if (id <= 0)
+        return;
+    size_t index = slotOf(id);
+    if (index >= slots.size() || slots[index].generation != generationOf(id) || slots[index].process)
+        return;
+    freeSlot(index);
+}
+
+void ProcessTable::insert(std::unique_ptr<Process> process)
+{
+    size_t index = slotOf(process->ID);
+    process->sequence = ++sequence;
+    dense.push_back(process.get());
+    link(process.get());
+    if (process->parent)
+        addChild(process->parent, process.get());
+    slots[index].process = std::move(process);
+}
+
+void ProcessTable::reserve(size_t count)
+{
+    dense.reserve(dense.size() + count);
+    if (count > freeSlots.size())
+    {
+        slots.reserve(slots.size() + count - freeSlots.size());
+    }
+}
+
+Process *ProcessTable::find(long id) const
+{
+    if (id <= 0)
+        return nullptr;
+    size_t index = slotOf(id);
+    if (index >= slots.size())
+        return nullptr;
+    const Slot &slot = slots[index];
+    if (slot.generation != generationOf(id) || !slot.process || !slot.process->running())
+        return nullptr;
+    return slot.process.get();
+}
+
+Process *ProcessTable::lookup(long id) const
+{
+    if (id <= 0)
+        return nullptr;
+    size_t index = slotOf(id);
+    if (index >= slots.size() || slots[index].generation != generationOf(id))
+        return nullptr;
+    return slots[index].process.get();
+}
+
+size_t ProcessTable::reap(std::vector<Process *> &parked)
+{
+    size_t alive = 0;
+    size_t slept = 0;
+    for (size_t i = 0; i < dense.size(); i++)
+    {
+        Process *process = dense[i];
+        if (!process->running())
+        {
+            freeSlot(slotOf(process->ID));
+            continue;
+        }
+        if (process->sleeping())
+        {
+            parked.push_back(process);
+            slept++;
+            continue;
+        }
+        dense[alive++] = process;
+    }
+    size_t dead = dense.size() - alive - slept;
+    asleep += slept;
+    dense.resize(alive);
+    for (Process *process : buried)
+    {
+        freeSlot(slotOf(process->ID));
+    }
+    dead += buried.size();
+    asleep -= buried.size();
+    buried.clear();
+    return dead;
+}
+
+void ProcessTable::wake(std::vector<Process *> &woken)
+{
+    if (woken.empty())
+        return;
+    std::sort(woken.begin(), woken.end(), [](Process *a, Process *b) { return a->sequence < b->sequence; });
+    size_t middle = dense.size();
+    dense.insert(dense.end(), woken.begin(), woken.end());
+    std::inplace_merge(dense.begin(), dense.begin() + middle, dense.end(),
+                       [](Process *a, Process *b) { return a->sequence < b->sequence; });
+    asleep -= woken.size();
+}
+
+void ProcessTable::bury(Process *process)
+{
+    buried.push_back(process);
+}
+
+void ProcessTable::clear()
+{
+    dense.clear();
+    buried.clear();
+    slots.clear();
+    freeSlots.clear();
+    registries.clear();
+    asleep = 0;
+}
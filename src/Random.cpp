@@ -0,0 +1,83 @@
+#include "pch.h"
+#include "Random.hpp"
+
+static uint64_t splitmix64(uint64_t &x)
+{
+    uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// 53 random bits to [0, 1)
+static const double UnitScale = 1.0 / 9007199254740992.0;
+
+Random::Random()
+{
+    seed(0, 0);
+}
+
+void Random::seed(uint64_t seed, uint64_t stream)
+{
+    uint64_t x = seed ^ splitmix64(stream);
+    for (int i = 0; i < 4; i++)
+    {
+        s[i] = splitmix64(x);
+    }
+}
+
+long Random::range(long min, long max)
+{
+    if (max < min)
+    {
+        long swap = min;
+        min = max;
+        max = swap;
+    }
+    uint64_t span = (uint64_t)max - (uint64_t)min + 1;
+    if (span == 0)
+    {
+        return (long)next();
+    }
+    return (long)((uint64_t)min + next() % span);
+}
+
+double Random::uniform(double min, double max)
+{
+    return min + (next() >> 11) * UnitScale * (max - min);
+}
+
+void Random::fill(double *out, size_t count, double min, double max)
+{
+    uint64_t s0[Lanes], s1[Lanes], s2[Lanes], s3[Lanes];
+    for (int lane = 0; lane < Lanes; lane++)
+    {
+        Random split;
+        split.seed(next(), lane);
+        s0[lane] = split.s[0];
+        s1[lane] = split.s[1];
+        s2[lane] = split.s[2];
+        s3[lane] = split.s[3];
+    }
+    double scale = UnitScale * (max - min);
+    size_t i = 0;
+    for (; i + Lanes <= count; i += Lanes)
+    {
+        for (int lane = 0; lane < Lanes; lane++)
+        {
+            uint64_t result = rotl(s1[lane] * 5, 7) * 9;
+            uint64_t t = s1[lane] << 17;
+            s2[lane] ^= s0[lane];
+            s3[lane] ^= s1[lane];
+            s1[lane] ^= s2[lane];
+            s0[lane] ^= s3[lane];
+            s2[lane] ^= t;
+            s3[lane] = rotl(s3[lane], 45);
+            out[i + lane] = min + (result >> 11) * scale;
+        }
+    }
+    for (; i < count; i++)
+    {
+        out[i] = uniform(min, max);
+    }
+}
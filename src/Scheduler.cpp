@@ -0,0 +1,678 @@
+#include "pch.h"
+#include "Interpreter.hpp"
+#include "Utils.hpp"
+#include "Input.hpp"
+
+// a run shorter than this is not worth waking the workers
+static const size_t ParallelMinimum = 8;
+static const size_t ParallelGrain = 16;
+
+thread_local ExecutionState *Interpreter::activeState = nullptr;
+
+// points the calling thread at a worker state for the duration of a range
+struct ActiveState
+{
+    ExecutionState *&slot;
+    ExecutionState *previous;
+
+    ActiveState(ExecutionState *&slot, ExecutionState *state) : slot(slot), previous(slot) { slot = state; }
+    ~ActiveState() { slot = previous; }
+};
+
+// a worker only sees the interpreter's scene and input while it ticks for it
+struct BoundScene
+{
+    Scene *previous;
+    Input *previousInput;
+
+    BoundScene(Scene *scene, Input *input) : previous(Scene::Bind(scene)), previousInput(Input::Bind(input)) {}
+    ~BoundScene()
+    {
+        Scene::Bind(previous);
+        Input::Bind(previousInput);
+    }
+};
+
+void Interpreter::setThreads(size_t count)
+{
+    jobs.start(count);
+    workerStates.clear();
+    for (size_t i = 0; i < jobs.workers(); i++)
+    {
+        std::unique_ptr<ExecutionState> exec = std::make_unique<ExecutionState>();
+        exec->environmentStack.push(mainEnvironment);
+        exec->context = std::make_shared<ExecutionContext>(this);
+        workerStates.push_back(std::move(exec));
+    }
+}
+
+// A type keeps at most this many dead processes for reuse
+static const size_t ProcessPoolLimit = 4096;
+
+std::unique_ptr<Process> Interpreter::acquireProcess(size_t index, const std::string &name, long id)
+{
+    if (index >= processPools.size())
+    {
+        processPools.resize(index + 1);
+    }
+    ProcessPool &pool = processPools[index];
+    if (pool.free.empty())
+    {
+        pool.created++;
+        return std::make_unique<Process>(this, name, id, index);
+    }
+    std::unique_ptr<Process> process = std::move(pool.free.back());
+    pool.free.pop_back();
+    process->reset(id);
+    pool.reused++;
+    return process;
+}
+
+// The locals go back to the pool with the process unless something else
+// still holds them, a process spawned from this one chains its scope to them.
+void Interpreter::recycleProcess(std::unique_ptr<Process> process)
+{
+    ProcessPool &pool = processPools[process->index];
+    if (pool.free.size() >= ProcessPoolLimit)
+    {
+        return;
+    }
+    process->frames.clear();
+    process->mailbox.clear();
+    process->inbox.clear();
+    process->instance = nullptr;
+    process->parent = nullptr;
+    if (process->environment && process->environment.use_count() > 1)
+    {
+        process->environment = nullptr;
+    }
+    pool.free.push_back(std::move(process));
+}
+
+const ProcessPool *Interpreter::getProcessPool(const std::string &name) const
+{
+    auto it = processListNames.find(name);
+    if (it == processListNames.end() || it->second >= processPools.size())
+    {
+        return nullptr;
+    }
+    return &processPools[it->second];
+}
+
+// Timers that came due bring their process back into the awake list before
+// the frame ticks, together with the sleepers sent s_wakeup. A timer whose
+// process was killed in its sleep finds a stale id and is dropped, one left
+// behind by an early wakeup no longer matches the process clock.
+void Interpreter::wakeSleepers()
+{
+    expired.clear();
+    frameWheel.advance(frameNumber, expired);
+    size_t frameTimers = expired.size();
+    timeWheel.advance((int64_t)gameTime, expired);
+    if (expired.empty() && interrupted.empty())
+    {
+        return;
+    }
+    sleepers.clear();
+    for (size_t i = 0; i < expired.size(); i++)
+    {
+        Process *process = processes.find(expired[i]);
+        int clock = i < frameTimers ? CLOCK_FRAMES : CLOCK_MILLIS;
+        int64_t now = i < frameTimers ? frameWheel.now() : timeWheel.now();
+        if (!process || !process->parked || process->sleepClock != clock || process->wakeAt > now)
+        {
+            continue;
+        }
+        process->parked = false;
+        sleepers.push_back(process);
+    }
+    for (long id : interrupted)
+    {
+        Process *process = processes.find(id);
+        if (!process || !process->parked)
+        {
+            continue;
+        }
+        process->parked = false;
+        sleepers.push_back(process);
+    }
+    interrupted.clear();
+    for (Process *process : sleepers)
+    {
+        process->sleepClock = CLOCK_NONE;
+        process->frameCredit = 0;
+    }
+    processes.wake(sleepers);
+    schedulerStats.woken += sleepers.size();
+}
+
+void Interpreter::signalProcess(Process *process, int signal, const Literal &value, long sender)
+{
+    if (signal & SIGNAL_TREE)
+    {
+        signalTree(process, signal & ~SIGNAL_TREE, sender);
+        return;
+    }
+    if (signal == SIGNAL_KILL && process->sleeping())
+    {
+        process->kill();
+        return;
+    }
+    process->post(signal, value, sender);
+    if (signal == SIGNAL_WAKEUP && process->sleeping())
+    {
+        interrupted.push_back(process->ID);
+    }
+}
+
+// Preorder walk of the links under root, no recursion and nothing visited
+// outside the subtree. A process killed this frame is still linked until
+// reap, so its children are reached through it.
+void Interpreter::signalTree(Process *root, int signal, long sender)
+{
+    Literal none;
+    Process *process = root;
+    while (process)
+    {
+        if (process->running())
+        {
+            signalProcess(process, signal, none, sender);
+        }
+        if (process->firstChild)
+        {
+            process = process->firstChild;
+            continue;
+        }
+        while (process != root && !process->nextSibling)
+        {
+            process = process->parent;
+        }
+        process = process == root ? nullptr : process->nextSibling;
+    }
+}
+
+size_t Interpreter::signalType(const std::string &typeName, int signal, long sender)
+{
+    long type = typeIndex(typeName);
+    if (type < 0)
+    {
+        Error("Process '" + typeName + "' not defined");
+        return 0;
+    }
+    size_t count = 0;
+    Literal none;
+    for (Process *process = firstOfType(type); process; process = process->typeNext)
+    {
+        if (process->running())
+        {
+            signalProcess(process, signal, none, sender);
+            count++;
+        }
+    }
+    return count;
+}
+
+long Interpreter::typeIndex(const std::string &typeName) const
+{
+    // script identifiers are lower case
+    std::string name = typeName;
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+    auto it = processListNames.find(name);
+    return it == processListNames.end() ? -1 : (long)it->second;
+}
+
+// The cursor keeps the id of the last process handed out, which still
+// resolves when the caller killed it in between, as in
+// while ((e = get_id("enemy")) != 0) kill(e);
+long Interpreter::nextOfType(long type, Process *caller)
+{
+    TypeCursor &cursor = caller ? caller->cursor : mainCursor;
+    Process *process = nullptr;
+    if (cursor.type != type || cursor.last == 0)
+    {
+        process = firstOfType(type);
+    }
+    else
+    {
+        Process *last = processes.lookup(cursor.last);
+        process = last && (long)last->index == type ? last->typeNext : nullptr;
+    }
+    while (process && !process->running())
+    {
+        process = process->typeNext;
+    }
+    cursor.type = type;
+    cursor.last = process ? process->ID : 0;
+    return cursor.last;
+}
+
+bool Interpreter::setTickRate(const std::string &typeName, double rate)
+{
+    long type = typeIndex(typeName);
+    if (type < 0)
+    {
+        return false;
+    }
+    processExecuter[type]->tickRate = std::max(0.0, rate);
+    for (Process *process = firstOfType(type); process; process = process->typeNext)
+    {
+        process->environment->builtin(LOCAL_TICK_RATE).setFloat(processExecuter[type]->tickRate);
+    }
+    return true;
+}
+
+size_t Interpreter::countOfType(long type) const
+{
+    size_t count = 0;
+    for (Process *process = firstOfType(type); process; process = process->typeNext)
+    {
+        if (process->running())
+            count++;
+    }
+    return count;
+}
+
+void Interpreter::parkSleepers()
+{
+    sleepers.clear();
+    processes.reap(sleepers);
+    for (Process *process : sleepers)
+    {
+        process->parked = true;
+        TimerWheel &wheel = process->sleepClock == CLOCK_FRAMES ? frameWheel : timeWheel;
+        wheel.schedule(process->ID, process->wakeAt);
+    }
+}
+
+void Interpreter::tickProcess(Process *process, ExecutionContext *context)
+{
+    if (!process->running())
+    {
+        return;
+    }
+    context->currentProcess = process;
+    context->internalProcess = process;
+    if (process->run())
+    {
+        schedulerStats.ticks++;
+    }
+    else
+    {
+        schedulerStats.skipped++;
+    }
+}
+
+// end of the run of parallel safe processes starting at begin, begin itself
+// when the run should be ticked on this thread
+size_t Interpreter::parallelSegment(size_t begin) const
+{
+    if (jobs.workers() <= 1)
+    {
+        return begin;
+    }
+    size_t end = begin;
+    while (end < processes.size())
+    {
+        ProcessExecution *execution = processExecuter[processes.at(end)->index].get();
+        // under a frame budget deferrable processes wait for the critical ones
+        if (!execution->parallel || (frameBudget > 0 && execution->deferrable))
+        {
+            break;
+        }
+        end++;
+    }
+    return end - begin >= ParallelMinimum ? end : begin;
+}
+
+// The processes of a segment only write their own locals and instance, so
+// they can tick in any order on any thread. Anything that reaches another
+// process or the scene keeps the process on the main thread, in table
+// order, which gives the same results as a single threaded run.
+void Interpreter::tickParallel(size_t begin, size_t end)
+{
+    std::atomic<size_t> ticks{0};
+    std::atomic<size_t> skipped{0};
+    size_t steals = jobs.getSteals();
+    Input *input = &Input::Get();
+    jobs.parallelFor(end - begin, ParallelGrain, [&](size_t first, size_t last, size_t worker)
+    {
+        ExecutionState *exec = worker == 0 ? &mainState : workerStates[worker].get();
+        ActiveState active(activeState, exec);
+        BoundScene bound(scene.get(), input);
+        ExecutionContext *context = exec->context.get();
+        size_t ran = 0;
+        size_t idle = 0;
+        for (size_t i = first; i < last; i++)
+        {
+            Process *process = processes.at(begin + i);
+            if (!process->running())
+            {
+                continue;
+            }
+            context->currentProcess = process;
+            context->internalProcess = process;
+            if (process->run())
+                ran++;
+            else
+                idle++;
+        }
+        context->currentProcess = nullptr;
+        context->internalProcess = nullptr;
+        ticks.fetch_add(ran, std::memory_order_relaxed);
+        skipped.fetch_add(idle, std::memory_order_relaxed);
+    });
+    schedulerStats.ticks += ticks;
+    schedulerStats.parallelTicks += ticks;
+    schedulerStats.skipped += skipped;
+    schedulerStats.segments++;
+    schedulerStats.steals += jobs.getSteals() - steals;
+}
+
+// Deferrable processes tick after the critical ones for as long as the frame
+// budget lasts, starting with the first one passed over last frame, so under
+// load they take turns instead of the same ones always missing out.
+void Interpreter::tickDeferred(ExecutionContext *context)
+{
+    size_t count = deferQueue.size();
+    auto first = std::lower_bound(deferQueue.begin(), deferQueue.end(), deferFrom,
+                                  [](Process *process, uint64_t sequence) { return process->sequence < sequence; });
+    size_t start = first == deferQueue.end() ? 0 : (size_t)(first - deferQueue.begin());
+    for (size_t n = 0; n < count; n++)
+    {
+        Process *process = deferQueue[(start + n) % count];
+        if (time_elapsed() - frameTime >= frameBudget)
+        {
+            deferFrom = process->sequence;
+            schedulerStats.deferred += count - n;
+            return;
+        }
+        tickProcess(process, context);
+    }
+}
+
+void Interpreter::recordFrame(double ms)
+{
+    frameTimes[schedulerStats.frames % frameTimes.size()] = ms;
+    schedulerStats.frames++;
+    schedulerStats.totalFrame += ms;
+    schedulerStats.maxFrame = std::max(schedulerStats.maxFrame, ms);
+    if (frameBudget > 0 && ms > frameBudget)
+    {
+        schedulerStats.overBudget++;
+    }
+}
+
+double Interpreter::framePercentile(double p) const
+{
+    size_t count = std::min(schedulerStats.frames, frameTimes.size());
+    if (count == 0)
+        return 0.0;
+    std::vector<double> sorted(frameTimes.begin(), frameTimes.begin() + count);
+    std::sort(sorted.begin(), sorted.end());
+    size_t at = (size_t)(p / 100.0 * (double)(count - 1));
+    return sorted[at];
+}
+
+bool Interpreter::setDeferrable(const std::string &typeName, bool deferrable)
+{
+    long type = typeIndex(typeName);
+    if (type < 0)
+    {
+        return false;
+    }
+    processExecuter[type]->deferrable = deferrable;
+    return true;
+}
+
+void Interpreter::classifyProcesses()
+{
+    size_t count = 0;
+    for (auto &execution : processExecuter)
+    {
+        ProcessStmt *process = processList[execution->name];
+        std::unordered_set<std::string> locals;
+        for (int i = 0; processLocals[i].name != NULL; i++)
+        {
+            locals.insert(processLocals[i].name);
+        }
+        for (auto &argument : process->parameter)
+        {
+            locals.insert(argument->name);
+        }
+        execution->parallel = parallelSafe(execution->body, locals);
+        if (execution->parallel)
+        {
+            count++;
+        }
+    }
+    Log(0, "%zu of %zu process types can tick in parallel", count, processExecuter.size());
+}
+
+bool Interpreter::parallelSafeCall(Stmt *callee, const std::vector<std::shared_ptr<Argument>> &parameter)
+{
+    auto it = safeCalls.find(callee);
+    if (it != safeCalls.end())
+    {
+        return it->second;
+    }
+    // recursion sees the callee as safe, the body decides
+    safeCalls[callee] = true;
+    std::unordered_set<std::string> locals;
+    for (auto &argument : parameter)
+    {
+        locals.insert(argument->name);
+    }
+    Stmt *body = callee->getType() == StmtType::FUNCTION ? static_cast<FunctionStmt *>(callee)->body.get()
+                                                          : static_cast<ProcedureStmt *>(callee)->body.get();
+    bool safe = parallelSafe(body, locals);
+    safeCalls[callee] = safe;
+    return safe;
+}
+
+bool Interpreter::parallelSafe(Stmt *stmt, std::unordered_set<std::string> &locals)
+{
+    if (!stmt)
+    {
+        return true;
+    }
+    switch (stmt->getType())
+    {
+    case StmtType::EMPTY_STMT:
+    case StmtType::BREAK:
+    case StmtType::CONTINUE:
+        return true;
+    case StmtType::FRAME:
+        return parallelSafe(static_cast<FrameStmt *>(stmt)->percent.get(), locals);
+    case StmtType::BLOCK:
+    {
+        std::unordered_set<std::string> scope = locals;
+        for (auto &child : static_cast<BlockStmt *>(stmt)->declarations)
+        {
+            if (!parallelSafe(child.get(), scope))
+                return false;
+        }
+        return true;
+    }
+    case StmtType::EXPRESSION:
+        return parallelSafe(static_cast<ExpressionStmt *>(stmt)->expression.get(), locals);
+    case StmtType::RETURN:
+        return parallelSafe(static_cast<ReturnStmt *>(stmt)->value.get(), locals);
+    case StmtType::VAR:
+    {
+        VarStmt *var = static_cast<VarStmt *>(stmt);
+        if (!parallelSafe(var->initializer.get(), locals))
+            return false;
+        for (auto &name : var->names)
+        {
+            locals.insert(name.lexeme);
+        }
+        return true;
+    }
+    case StmtType::IF:
+    {
+        IfStmt *branch = static_cast<IfStmt *>(stmt);
+        if (!parallelSafe(branch->condition.get(), locals) || !parallelSafe(branch->thenBranch.get(), locals))
+            return false;
+        for (auto &elif : branch->elifBranch)
+        {
+            if (!parallelSafe(elif->condition.get(), locals) || !parallelSafe(elif->thenBranch.get(), locals))
+                return false;
+        }
+        return parallelSafe(branch->elseBranch.get(), locals);
+    }
+    case StmtType::SWITCH:
+    {
+        SwitchStmt *branch = static_cast<SwitchStmt *>(stmt);
+        if (!parallelSafe(branch->expression.get(), locals))
+            return false;
+        for (auto &caseStmt : branch->cases)
+        {
+            if (!parallelSafe(caseStmt->value.get(), locals) || !parallelSafe(caseStmt->body.get(), locals))
+                return false;
+        }
+        return parallelSafe(branch->default_case.get(), locals);
+    }
+    case StmtType::WHILE:
+    {
+        WhileStmt *loop = static_cast<WhileStmt *>(stmt);
+        return parallelSafe(loop->condition.get(), locals) && parallelSafe(loop->body.get(), locals);
+    }
+    case StmtType::REPEAT:
+    {
+        RepeatStmt *loop = static_cast<RepeatStmt *>(stmt);
+        return parallelSafe(loop->condition.get(), locals) && parallelSafe(loop->body.get(), locals);
+    }
+    case StmtType::LOOP:
+        return parallelSafe(static_cast<LoopStmt *>(stmt)->body.get(), locals);
+    case StmtType::FOR:
+    {
+        ForStmt *loop = static_cast<ForStmt *>(stmt);
+        return parallelSafe(loop->initializer.get(), locals) && parallelSafe(loop->condition.get(), locals) &&
+               parallelSafe(loop->step.get(), locals) && parallelSafe(loop->body.get(), locals);
+    }
+    case StmtType::PROCEDURECALL:
+    {
+        ProcedureCallStmt *call = static_cast<ProcedureCallStmt *>(stmt);
+        for (auto &argument : call->arguments)
+        {
+            if (!parallelSafe(argument.get(), locals))
+                return false;
+        }
+        auto it = procedureList.find(call->name.lexeme);
+        return it != procedureList.end() && parallelSafeCall(it->second, it->second->parameter);
+    }
+    default:
+        // print keeps its order on the main thread
+        return false;
+    }
+}
+
+bool Interpreter::parallelSafe(Expr *expr, std::unordered_set<std::string> &locals)
+{
+    if (!expr)
+    {
+        return true;
+    }
+    switch (expr->getType())
+    {
+    case ExprType::EMPTY_EXPR:
+    case ExprType::LITERAL:
+    case ExprType::NOW:
+    case ExprType::VARIABLE:
+        return true;
+    case ExprType::GROUPING:
+        return parallelSafe(static_cast<GroupingExpr *>(expr)->expression.get(), locals);
+    case ExprType::BINARY:
+    {
+        BinaryExpr *binary = static_cast<BinaryExpr *>(expr);
+        return parallelSafe(binary->left.get(), locals) && parallelSafe(binary->right.get(), locals);
+    }
+    case ExprType::LOGICAL:
+    {
+        LogicalExpr *logical = static_cast<LogicalExpr *>(expr);
+        return parallelSafe(logical->left.get(), locals) && parallelSafe(logical->right.get(), locals);
+    }
+    case ExprType::UNARY:
+    {
+        UnaryExpr *unary = static_cast<UnaryExpr *>(expr);
+        if ((unary->op.type == TokenType::INC || unary->op.type == TokenType::DEC) &&
+            unary->right->getType() == ExprType::VARIABLE &&
+            !locals.count(static_cast<VariableExpr *>(unary->right.get())->name.lexeme))
+        {
+            return false;
+        }
+        return parallelSafe(unary->right.get(), locals);
+    }
+    case ExprType::ASSIGN:
+    {
+        AssignExpr *assign = static_cast<AssignExpr *>(expr);
+        return locals.count(assign->name.lexeme) && parallelSafe(assign->value.get(), locals);
+    }
+    case ExprType::CALLER:
+    {
+        CallerExpr *call = static_cast<CallerExpr *>(expr);
+        for (auto &argument : call->parameters)
+        {
+            if (!parallelSafe(argument.get(), locals))
+                return false;
+        }
+        if (call->caller == 1)
+        {
+            auto it = functionList.find(call->name);
+            return it != functionList.end() && parallelSafeCall(it->second, it->second->parameter);
+        }
+        if (call->caller == 2)
+        {
+            return localNatives.count(call->name) > 0;
+        }
+        // spawning touches the process table and the scene
+        return false;
+    }
+    default:
+        return false;
+    }
+}
+
+void Interpreter::printSchedulerStats() const
+{
+    Log(0, "Scheduler threads: %zu ticks: %zu skipped: %zu parallel: %zu (%.1f%%) segments: %zu steals: %zu",
+        jobs.workers(), schedulerStats.ticks, schedulerStats.skipped, schedulerStats.parallelTicks,
+        schedulerStats.ticks ? 100.0 * schedulerStats.parallelTicks / schedulerStats.ticks : 0.0,
+        schedulerStats.segments, schedulerStats.steals);
+    Log(0, "Scheduler sleeping: %zu woken: %zu", processes.sleeping(), schedulerStats.woken);
+    Log(0, "Scheduler frames: %zu avg: %.3f ms p50: %.3f ms p95: %.3f ms p99: %.3f ms max: %.3f ms",
+        schedulerStats.frames, schedulerStats.frames ? schedulerStats.totalFrame / schedulerStats.frames : 0.0,
+        framePercentile(50.0), framePercentile(95.0), framePercentile(99.0), schedulerStats.maxFrame);
+    if (frameBudget > 0)
+    {
+        Log(0, "Scheduler budget: %.2f ms deferred: %zu over budget: %zu frames", frameBudget, schedulerStats.deferred,
+            schedulerStats.overBudget);
+    }
+    if (tickBudget > 0)
+    {
+        size_t preempted = mainState.preempted;
+        size_t killed = mainState.budgetKills;
+        for (auto &exec : workerStates)
+        {
+            preempted += exec->preempted;
+            killed += exec->budgetKills;
+        }
+        Log(0, "Scheduler tick budget: %ld statements preempted: %zu killed: %zu", tickBudget, preempted, killed);
+    }
+}
+
+void Interpreter::printPoolStats() const
+{
+    for (auto &execution : processExecuter)
+    {
+        if ((size_t)execution->index >= processPools.size())
+        {
+            continue;
+        }
+        const ProcessPool &pool = processPools[execution->index];
+        size_t spawns = pool.created + pool.reused;
+        Log(0, "Process pool %-12s spawns: %zu created: %zu reused: %zu (%.1f%%) free: %zu", execution->name.c_str(), spawns,
+            pool.created, pool.reused, spawns ? 100.0 * pool.reused / spawns : 0.0, pool.free.size());
+    }
+    Log(0, "Instance pool free: %zu", Scene::Get().PooledInstances());
+}
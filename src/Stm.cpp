@@ -3,14 +3,9 @@
 #include "Stm.hpp"
 
 
-static unsigned long StatementID = 0;
-
 Program::Program(const std::string &name, std::vector<std::shared_ptr<Stmt>> statements, std::shared_ptr<Stmt> block):
 name(name), statements(std::move(statements)), statement(std::move(block))
 {
-     StatementID = 0;
-     ID = StatementID;
-     StatementID++;
 }
 
 void Program::accept(Visitor *visitor)
@@ -22,7 +17,6 @@ PrintStmt::PrintStmt(std::shared_ptr<Expr> expression)
 :expression(std::move(expression))
 {
      
-     ID = StatementID;
      
 }
 
@@ -42,7 +36,6 @@ ExpressionStmt::ExpressionStmt(std::shared_ptr<Expr> expression)
 :expression(std::move(expression))
 {
 
-     ID = StatementID;
      
 }
 
@@ -55,7 +48,6 @@ VarStmt::VarStmt(std::vector<Token> names, std::shared_ptr<Expr> initializer, Li
  names(std::move(names)), initializer(std::move(initializer)), type(type) 
 {
 
-     ID = StatementID;
 }
 
 void VarStmt::accept(Visitor *visitor)
@@ -72,8 +64,6 @@ ProcedureStmt::ProcedureStmt(const std::string &name, std::vector<std::shared_pt
 name(name), parameter(parameter), body(std::move(body)) 
 {
     
-     ID = StatementID;
-     StatementID++;
 }
 
 void ProcedureStmt::accept(Visitor *visitor)
@@ -84,7 +74,6 @@ void ProcedureStmt::accept(Visitor *visitor)
 ProcedureCallStmt::ProcedureCallStmt(const Token &name, std::vector<std::shared_ptr<Expr>> arguments):
 name(name), arguments(std::move(arguments)) 
 {
-     ID = StatementID;
 }
 
 void ProcedureCallStmt::accept(Visitor *visitor)
@@ -95,8 +84,6 @@ void ProcedureCallStmt::accept(Visitor *visitor)
 FunctionStmt::FunctionStmt(const std::string &name, LiteralType returnType, std::vector<std::shared_ptr<Argument>> parameter, std::shared_ptr<Stmt> body)
 : name(name), returnType(returnType), parameter(std::move(parameter)), body(std::move(body)) 
 {
-     ID = StatementID;
-     StatementID++;
 }
 
 void FunctionStmt::accept(Visitor *visitor)
@@ -106,7 +93,6 @@ void FunctionStmt::accept(Visitor *visitor)
 
 ReturnStmt::ReturnStmt(std::shared_ptr<Expr> value): value(std::move(value)) 
 {
-     ID = StatementID;
 }
 
 void ReturnStmt::accept(Visitor *visitor)
@@ -117,7 +103,6 @@ void ReturnStmt::accept(Visitor *visitor)
 IfStmt::IfStmt(std::shared_ptr<Expr> condition, std::shared_ptr<Stmt> thenBranch, std::shared_ptr<Stmt> elseBranch, std::vector<std::unique_ptr<ElifStmt>> elifBranch)
     : condition(std::move(condition)), thenBranch(std::move(thenBranch)), elseBranch(std::move(elseBranch)), elifBranch(std::move(elifBranch)) 
 {
-     ID = StatementID;
 }
 
 void IfStmt::accept(Visitor *visitor)
@@ -128,7 +113,6 @@ void IfStmt::accept(Visitor *visitor)
 WhileStmt::WhileStmt(std::shared_ptr<Expr> condition, std::shared_ptr<Stmt> body)
 : condition(std::move(condition)), body(std::move(body)) 
 {
-     ID = StatementID;
 }
 
 void WhileStmt::accept(Visitor *visitor)
@@ -138,7 +122,6 @@ void WhileStmt::accept(Visitor *visitor)
 
 BreakStmt::BreakStmt()
 {
-    ID = StatementID;
 }
 
 void BreakStmt::accept(Visitor *visitor)
@@ -148,7 +131,6 @@ void BreakStmt::accept(Visitor *visitor)
 
 ContinueStmt::ContinueStmt()
 {
-    ID = StatementID;
 }
 
 void ContinueStmt::accept(Visitor *visitor)
@@ -156,10 +138,18 @@ void ContinueStmt::accept(Visitor *visitor)
      visitor->visitContinueStmt(this);
 }
 
+FrameStmt::FrameStmt(std::shared_ptr<Expr> percent) : percent(std::move(percent))
+{
+}
+
+void FrameStmt::accept(Visitor *visitor)
+{
+     visitor->visitFrameStmt(this);
+}
+
 RepeatStmt::RepeatStmt(std::shared_ptr<Expr> condition, std::shared_ptr<Stmt> body)
 : condition(std::move(condition)), body(std::move(body)) 
 {
-     ID = StatementID;
 }
 
 void RepeatStmt::accept(Visitor *visitor)
@@ -171,8 +161,6 @@ LoopStmt::LoopStmt(std::shared_ptr<Stmt> body)
 :  body(std::move(body)) 
 {
 
-     ID = StatementID;
-     StatementID++;
  
      
 }
@@ -185,7 +173,6 @@ void LoopStmt::accept(Visitor *visitor)
 SwitchStmt::SwitchStmt(std::shared_ptr<Expr> expression, std::shared_ptr<Stmt> default_case, std::vector<std::unique_ptr<CaseStmt>> cases)
 : expression(std::move(expression)), default_case(std::move(default_case)), cases(std::move(cases)) 
 {
-     ID = StatementID;
 }
 
 void SwitchStmt::accept(Visitor *visitor)
@@ -196,7 +183,6 @@ void SwitchStmt::accept(Visitor *visitor)
 ForStmt::ForStmt(std::shared_ptr<Stmt> initializer, std::shared_ptr<Expr> condition, std::shared_ptr<Expr> step, std::shared_ptr<Stmt> body)
 : initializer(std::move(initializer)), condition(std::move(condition)), step(std::move(step)), body(std::move(body))
 {
-     ID = StatementID;
 }
 
 void ForStmt::accept(Visitor *visitor)
@@ -207,7 +193,6 @@ void ForStmt::accept(Visitor *visitor)
 ProcessStmt::ProcessStmt(std::string name, std::vector<std::shared_ptr<Argument>> parameter, std::shared_ptr<Stmt> body)
 : name(std::move(name)), parameter(std::move(parameter)), body(std::move(body)) 
 {
-     ID = StatementID;
      index = 0;
 }
 
@@ -219,13 +204,10 @@ void ProcessStmt::accept(Visitor *visitor)
 
 EmptyStmt::EmptyStmt()
 {
-    ID = StatementID;
 }
 BlockStmt::BlockStmt(std::vector<std::shared_ptr<Stmt>> declarations):declarations(std::move(declarations))
 {
      
-     ID = StatementID;
-     StatementID++;
 }
 
 CaseStmt::CaseStmt(std::shared_ptr<Expr> value, std::shared_ptr<Stmt> body)
@@ -0,0 +1,92 @@
+#include "pch.h"
+#include "TimerWheel.hpp"
+
+static const int64_t SlotMask = TimerWheel::Slots - 1;
+
+TimerWheel::TimerWheel() : current(0), pending(0)
+{
+}
+
+void TimerWheel::schedule(long id, int64_t due)
+{
+    place({id, std::max(due, current + 1)});
+    pending++;
+}
+
+// A timer sits on the lowest level whose digit is the first one where its
+// due tick and the clock differ, so it is cascaded exactly when the clock
+// reaches the start of its slot.
+void TimerWheel::place(const Timer &timer)
+{
+    for (int level = 0; level < Levels; level++)
+    {
+        int shift = (level + 1) * SlotBits;
+        if ((timer.due >> shift) == (current >> shift))
+        {
+            wheel[level][(timer.due >> (level * SlotBits)) & SlotMask].push_back(timer);
+            return;
+        }
+    }
+    overflow.push_back(timer);
+}
+
+void TimerWheel::cascade(int level)
+{
+    std::vector<Timer> timers;
+    if (level == Levels)
+    {
+        timers.swap(overflow);
+    }
+    else
+    {
+        timers.swap(wheel[level][(current >> (level * SlotBits)) & SlotMask]);
+    }
+    for (const Timer &timer : timers)
+    {
+        place(timer);
+    }
+}
+
+void TimerWheel::advance(int64_t now, std::vector<long> &expired)
+{
+    if (pending == 0)
+    {
+        current = std::max(current, now);
+        return;
+    }
+    while (current < now && pending > 0)
+    {
+        current++;
+        // the highest level whose slot starts at this tick, cascaded top down
+        int top = 0;
+        while (top < Levels && (current & ((int64_t(1) << ((top + 1) * SlotBits)) - 1)) == 0)
+        {
+            top++;
+        }
+        for (int level = top; level >= 1; level--)
+        {
+            cascade(level);
+        }
+        std::vector<Timer> &slot = wheel[0][current & SlotMask];
+        for (const Timer &timer : slot)
+        {
+            expired.push_back(timer.id);
+        }
+        pending -= slot.size();
+        slot.clear();
+    }
+    current = std::max(current, now);
+}
+
+void TimerWheel::clear()
+{
+    for (auto &level : wheel)
+    {
+        for (auto &slot : level)
+        {
+            slot.clear();
+        }
+    }
+    overflow.clear();
+    pending = 0;
+}
@@ -32,13 +32,18 @@ void Log(int severity, const char* fmt, ...)
 
 
 		time_t rawTime;
-		struct tm* timeInfo;
+		struct tm timeInfo;
 		char timeBuffer[80];
 
+		// batch jobs log from several threads
 		time(&rawTime);
-		timeInfo = localtime(&rawTime);
+#if defined(_WIN32)
+		localtime_s(&timeInfo, &rawTime);
+#else
+		localtime_r(&rawTime, &timeInfo);
+#endif
 
-		strftime(timeBuffer, sizeof(timeBuffer), "[%H:%M:%S]", timeInfo);
+		strftime(timeBuffer, sizeof(timeBuffer), "[%H:%M:%S]", &timeInfo);
 
 		char consoleFormat[1024];
 		snprintf(consoleFormat, 1024, "%s%s %s%s%s: %s\n", CONSOLE_COLOR_CYAN,
@@ -16,7 +16,17 @@
 
 
 #include "Core.hpp"
+#include "Input.hpp"
+#include "Batch.hpp"
 extern void register_core(Interpreter *interpreter);
+extern void register_heap(Interpreter *interpreter);
+
+// the simulation runs at a fixed rate whatever the frame rate
+static const double SimulationStep = 1.0 / 60.0;
+// steps one rendered frame may catch up, past that the game slows down
+static const int MaxStepsPerFrame = 5;
+// frames a headless run without --frames or a tape goes for
+static const long HeadlessFrames = 600;
 
 
 std::string readFile(const std::string& filePath)
@@ -73,11 +83,187 @@ LiteralPtr native_writeln(ExecutionContext* ctx, int argc)
 
 
 
-int main()
+static void usage()
 {
+    Log(1, "Usage: main [--script file] [--record tape | --replay tape] [--headless] [--frames n] [--threads n]");
+    Log(1, "       main --batch [--frames n] [--threads n] script...");
+}
 
-   
-         std::string code = readFile("main.pc");
+static double milliseconds(std::chrono::steady_clock::duration duration)
+{
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+// Without a window or GPU, for build servers: runs frames simulation steps
+// as fast as they go, each one the script, the scene refresh and what a
+// rendered frame prepares before drawing, and logs the time of each phase.
+// frames 0 runs until a replay ends.
+static void runHeadless(Interpreter &interpreter, long frames)
+{
+    typedef std::chrono::steady_clock Clock;
+    double script = 0;
+    double refresh = 0;
+    double prepare = 0;
+    long frame = 0;
+    Clock::time_point start = Clock::now();
+    while (frames <= 0 || frame < frames)
+    {
+        Input::Get().BeginStep(SimulationStep);
+        if (Input::Get().Finished())
+            break;
+        Clock::time_point begin = Clock::now();
+        Scene::Get().SaveState();
+        bool running = interpreter.run();
+        Clock::time_point ran = Clock::now();
+        Scene::Get().Refresh();
+        Clock::time_point refreshed = Clock::now();
+        Scene::Get().Prepare(SimulationStep);
+        Clock::time_point prepared = Clock::now();
+
+        script += milliseconds(ran - begin);
+        refresh += milliseconds(refreshed - ran);
+        prepare += milliseconds(prepared - refreshed);
+        frame++;
+        if (!running)
+            break;
+    }
+    double total = milliseconds(Clock::now() - start);
+    double perFrame = frame > 0 ? 1.0 / frame : 0.0;
+    double share = total > 0 ? 100.0 / total : 0.0;
+    size_t ticks = interpreter.getSchedulerStats().ticks;
+
+    Log(0, "Headless: %ld frames in %.2f ms (%.1f frames/s), threads: %zu", frame, total,
+        total > 0 ? frame * 1000.0 / total : 0.0, interpreter.getThreads());
+    Log(0, "  script      %10.2f ms  %8.4f ms/frame  %5.1f%%", script, script * perFrame, script * share);
+    Log(0, "  refresh     %10.2f ms  %8.4f ms/frame  %5.1f%%", refresh, refresh * perFrame, refresh * share);
+    Log(0, "  render-prep %10.2f ms  %8.4f ms/frame  %5.1f%%", prepare, prepare * perFrame, prepare * share);
+    Log(0, "  %zu process ticks, %.0f ticks/s", ticks, total > 0 ? ticks * 1000.0 / total : 0.0);
+}
+
+// Every script in an interpreter of its own, threads of them at once, and a
+// line per job in the order they were given. Fails when a job did not
+// compile or stopped on an error.
+static int runBatch(const std::vector<std::string> &scripts, long frames, long threads)
+{
+    std::vector<BatchJob> jobs;
+    for (const std::string &script : scripts)
+    {
+        try
+        {
+            jobs.push_back({script, readFile(script)});
+        }
+        catch (const std::runtime_error &e)
+        {
+            Log(2, "%s (%s)", e.what(), script.c_str());
+            return 1;
+        }
+    }
+    SetTraceLogLevel(LOG_NONE);
+    SetTraceLogCallback(Native_TraceLog);
+
+    std::vector<BatchResult> results = RunBatch(jobs, (size_t)frames, (size_t)threads);
+    int failed = 0;
+    for (const BatchResult &result : results)
+    {
+        if (!result.compiled || !result.error.empty())
+        {
+            Log(2, "job %s failed: %s", result.name.c_str(), result.compiled ? result.error.c_str() : "does not compile");
+            failed++;
+            continue;
+        }
+        Log(0, "job %s frames %zu processes %zu ticks %zu (%.2f ms)", result.name.c_str(), result.frames,
+            result.processes, result.ticks, result.elapsed);
+    }
+    return failed > 0 ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+         std::string script = "main.pc";
+         std::string record;
+         std::string replay;
+         bool headless = false;
+         bool batch = false;
+         std::vector<std::string> scripts;
+         long frames = 0;
+         // all cores with a window; a headless run takes one unless told,
+         // so its timing report compares between machines
+         long threads = -1;
+         for (int i = 1; i < argc; i++)
+         {
+            std::string arg = argv[i];
+            if (arg == "--script" && i + 1 < argc)
+                script = argv[++i];
+            else if (arg == "--record" && i + 1 < argc)
+                record = argv[++i];
+            else if (arg == "--replay" && i + 1 < argc)
+                replay = argv[++i];
+            else if (arg == "--frames" && i + 1 < argc)
+                frames = std::atol(argv[++i]);
+            else if (arg == "--threads" && i + 1 < argc)
+                threads = std::atol(argv[++i]);
+            else if (arg == "--headless")
+                headless = true;
+            else if (arg == "--batch")
+                batch = headless = true;
+            else if (batch && arg.compare(0, 2, "--") != 0)
+                scripts.push_back(arg);
+            else
+            {
+                Log(2, "Unknown option %s", arg.c_str());
+                usage();
+                return 1;
+            }
+         }
+         if (!record.empty() && !replay.empty())
+         {
+            Log(2, "--record and --replay can not be used together");
+            return 1;
+         }
+         if (batch && (scripts.empty() || !replay.empty()))
+         {
+            Log(2, "--batch takes the scripts to run and no tape");
+            return 1;
+         }
+         if (headless && !record.empty())
+         {
+            Log(2, "--headless has no input to record");
+            return 1;
+         }
+         if (frames < 0 || (frames > 0 && !headless))
+         {
+            Log(2, "--frames takes a count and goes with --headless");
+            return 1;
+         }
+         if (threads == 0 || threads < -1)
+         {
+            Log(2, "--threads takes a count of at least 1");
+            return 1;
+         }
+         if (threads < 0)
+         {
+            threads = headless ? 1 : (long)std::max(1u, std::thread::hardware_concurrency());
+         }
+         // nothing else would end a headless run without a tape
+         if (headless && replay.empty() && frames == 0)
+         {
+            frames = HeadlessFrames;
+         }
+         if (batch)
+         {
+            return runBatch(scripts, frames, threads);
+         }
+
+         std::string code;
+         try
+         {
+            code = readFile(script);
+         }
+         catch (const std::runtime_error &e)
+         {
+            Log(2, "%s (%s)", e.what(), script.c_str());
+            return 1;
+         }
          
          Interpreter interpreter;
 
@@ -90,40 +276,85 @@ int main()
             SetTraceLogLevel(LOG_NONE);
             SetTraceLogCallback(Native_TraceLog);
 
-            InitWindow(screenWidth, screenHeight, "BuLang with Raylib");
-            SetTargetFPS(1000);
+            if (!headless)
+            {
+                InitWindow(screenWidth, screenHeight, "BuLang with Raylib");
+                SetTargetFPS(1000);
+            }
 
 
             interpreter.init();
 
             register_core(&interpreter);
+            register_heap(&interpreter);
+            interpreter.setThreads((size_t)threads);
+            interpreter.setFixedStep(SimulationStep);
 
         bool sucess = false;
         std::string text = "";
 
     try
     {
+            if (!record.empty() && !Input::Get().Record(record))
+            {
+                throw std::runtime_error("Could not record to " + record);
+            }
+            if (!replay.empty() && !Input::Get().Replay(replay))
+            {
+                throw std::runtime_error("Could not replay " + replay);
+            }
+            if (headless && replay.empty())
+            {
+                Input::Get().Disable();
+            }
+
             if (interpreter.compile(code))
             {
                 sucess = true;
             }
         
 
-            while (!WindowShouldClose() && !sucess)   
+            Scene::Get().SetFixedStep(SimulationStep);
+            bool running = sucess;
+            if (headless && running)
             {
-
-                
-
+                runHeadless(interpreter, frames);
+            }
+            double previous = GetTime();
+            double accumulator = SimulationStep;
+            while (!headless && !WindowShouldClose() && running)   
+            {
+                double now = GetTime();
+                accumulator += now - previous;
+                previous = now;
+
+                Input::Get().Poll();
+                int steps = 0;
+                while (accumulator >= SimulationStep && steps < MaxStepsPerFrame)
+                {
+                        Input::Get().BeginStep(SimulationStep);
+                        if (Input::Get().Finished())
+                        {
+                            running = false;
+                            break;
+                        }
+                        Scene::Get().SaveState();
                         if (!interpreter.run())
                         {
+                            running = false;
                             break;
                         }
-                        
-                    
+                        accumulator -= SimulationStep;
+                        steps++;
+                }
+                if (accumulator >= SimulationStep)
+                {
+                    accumulator = std::fmod(accumulator, SimulationStep);
+                }
 
                 BeginDrawing();
 
-                Scene::Get().UpdateAndRefresh();
+                Scene::Get().UpdateAndRefresh(accumulator / SimulationStep);
        
 
                 EndDrawing();
@@ -148,10 +379,17 @@ catch (const std::runtime_error& e)
    
  
 
+Input::Get().Stop();
 
+interpreter.getHeap().printStats();
+interpreter.printSchedulerStats();
+interpreter.printPoolStats();
+Memory::printStats();
 interpreter.cleanup();
 Scene::Get().Clear();
-CloseWindow(); 
+if (!headless)
+    CloseWindow(); 
+Factory::Instance().printStats();
 Factory::Instance().clear();
 
 